@@ -27,6 +27,24 @@
 #include <cmath>
 #include <stack>
 #include <queue>
+#include <bitset>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <unistd.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#ifdef PATH_DEFENSE_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
 
 using namespace std;
 
@@ -39,10 +57,38 @@ const int NOT_FOUND        = -1;     //! 敵を見つけたか見つけてない
 const int MAX_N            = 60 + 2; //! ボードの最大長(番兵込み)
 const int MAX_Z            = 2015;   //! 敵の最大数(実際は2000が最大)
 const int MAX_B            = 10;     //! 基地の最大数(実際は8が最大)
+const int MAX_S            = 4*MAX_N;//! スポーン地点の最大数(マップの端のセル数)
 const int MAX_T            = 25;     //! タワーの最大数(実際は20が最大)
 const int MAX_R            = 5;      //! 攻撃範囲の最大値
 const int BASE_INIT_HEALTH = 1000;   //! 基地の初期体力(1000固定)
 const int LIMIT_TURN       = 2000;   //! ターンの上限
+const int BUILD_TREE_SIZE  = 4096;   //! 建設候補のセグメント木の葉の数(MAX_N*MAX_N以上の2の冪)
+const int ROLLOUT_COUNT    = 8;      //! 1回の先読みで行うロールアウトの数
+const int MAX_ROLLOUT_COUNT = 64;    //! 時間に余裕がある時のロールアウトの最大数
+const int MAX_SEARCH_DEPTH  = 4;     //! 先読みを深くする段階の数
+const int MIN_BUILD_ATTEMPT = 2;     //! 1ターンに必ず試す建設の回数
+const int MAX_BUILD_ATTEMPT = 4;     //! 時間に余裕がある時に試す建設の最大回数
+const double BURST_RATE    = 4.0;    //! 1ターンに使って良い時間(残り時間の均等割りの何倍か)
+
+/*
+ * ソルバー全体で使って良い時間(ms)。制限時間は20秒なので半分を目安にする。
+ * 0にすると時間を見ずに最低限の探索だけを行う(結果が実行毎に変わらない)
+ */
+#ifndef PATH_DEFENSE_TIME_LIMIT
+#define PATH_DEFENSE_TIME_LIMIT 10000
+#endif
+const double TIME_LIMIT = PATH_DEFENSE_TIME_LIMIT;
+
+/*
+ * ロールアウトに使うスレッドの最大数。
+ * 1ゲーム毎にプロセスを分けてコアを使い切るベンチマークでは1にする
+ */
+#ifndef PATH_DEFENSE_MAX_THREAD
+#define PATH_DEFENSE_MAX_THREAD 8
+#endif
+const int MAX_THREAD = PATH_DEFENSE_MAX_THREAD;
+
+const int TRACE_VERSION = 1;  //! トレースファイルの形式のバージョン
 
 /*
  * それぞれの方角と数値の対応
@@ -65,6 +111,224 @@ const int UP    = 4; //! 0100
 const int RIGHT = 8; //! 1000
 
 const int directMask[4] = {DOWN, LEFT, UP, RIGHT};
+
+/*
+ * プロファイラ
+ *
+ * PATH_DEFENSE_PROFILE を定義してコンパイルした時だけ有効になる。
+ * 定義しない場合はPROFILE_*のマクロが空になるので、計測用のコードは何も残らない
+ */
+
+/**
+ * @enum Enum
+ * 計測する処理の区間
+ */
+enum ProfilePhase {
+  PHASE_UPDATE_BOARD_DATA,
+  PHASE_RESET_CELL_DEFENSE_VALUE,
+  PHASE_UPDATE_CREEPS_DATA,
+  PHASE_EVALUATE_THREAT,
+  PHASE_APPLY_THREAT,
+  PHASE_SEARCH_BEST_BUILD_POINT,
+  PHASE_BUILD_TOWER,
+  PHASE_COUNT
+};
+
+/**
+ * @enum Enum
+ * 数を数えるもの
+ */
+enum ProfileCounter {
+  //! 幅優先探索で展開したセルの数
+  COUNTER_BFS_NODES,
+
+  //! calcBuildValueの呼び出し回数
+  COUNTER_CALC_BUILD_VALUE,
+
+  //! シミュレーションで敵を1歩動かした回数
+  COUNTER_CREEP_STEPS,
+
+  //! ロールアウトの回数
+  COUNTER_ROLLOUTS,
+
+  //! 距離場の判定でロールアウトを省略した回数
+  COUNTER_SKIPPED_THREATS,
+
+  //! シミュレーションでタワーの攻撃を処理したステップの数
+  COUNTER_ATTACK_STEPS,
+
+  //! シミュレーションで何も起きないので飛ばしたステップの数
+  COUNTER_IDLE_STEPS,
+
+  COUNTER_COUNT
+};
+
+#ifdef PATH_DEFENSE_PROFILE
+
+const char *PHASE_NAMES[PHASE_COUNT] = {
+  "updateBoardData", "resetCellDefenseValue", "updateCreepsData", "evaluateThreat",
+  "applyThreat", "searchBestBuildPoint", "buildTower"
+};
+
+const char *COUNTER_NAMES[COUNTER_COUNT] = {
+  "bfsNodes", "calcBuildValueCalls", "creepSteps", "rollouts", "skippedThreats",
+  "attackSteps", "idleSteps"
+};
+
+/**
+ * @fn [complete]
+ * サイクルカウンタを読む(x86以外はナノ秒)
+ */
+inline unsigned long long readCycleCounter(){
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+const int HISTOGRAM_SUB_BITS  = 3;                        //! 2の冪の区間を2^3に等分する
+const int HISTOGRAM_SIZE      = 64 << HISTOGRAM_SUB_BITS; //! バケットの数
+
+/**
+ * @brief 対数線形ヒストグラム
+ *
+ * @detail
+ * 値を2の冪の区間に分け、各区間をさらに等分したバケットで数える(相対誤差は1/8以下)。
+ * 8未満の値はそのままバケットの番号になる
+ */
+typedef struct logLinearHistogram {
+  ll bucketCount[HISTOGRAM_SIZE];   // バケット毎の個数
+  ll count;                         // 記録した個数
+  unsigned long long maxValue;      // 最大値
+
+  logLinearHistogram(){
+    memset(bucketCount, 0, sizeof(bucketCount));
+    this->count     = 0;
+    this->maxValue  = 0;
+  }
+
+  /**
+   * @fn [complete]
+   * 値の入るバケットの番号を返す
+   */
+  static int bucketOf(unsigned long long value){
+    if(value < (1ULL << HISTOGRAM_SUB_BITS)) return value;
+
+    int exponent = 63 - __builtin_clzll(value);
+    int group = exponent - HISTOGRAM_SUB_BITS + 1;
+    int sub = (value >> (exponent - HISTOGRAM_SUB_BITS)) & ((1 << HISTOGRAM_SUB_BITS) - 1);
+
+    return (group << HISTOGRAM_SUB_BITS) + sub;
+  }
+
+  /**
+   * @fn [complete]
+   * バケットに入る値の上限を返す
+   */
+  static unsigned long long upperBoundOf(int bucket){
+    if(bucket < (1 << HISTOGRAM_SUB_BITS)) return bucket;
+
+    int group = bucket >> HISTOGRAM_SUB_BITS;
+    int sub = bucket & ((1 << HISTOGRAM_SUB_BITS) - 1);
+    unsigned long long lower = (unsigned long long)((1 << HISTOGRAM_SUB_BITS) + sub) << (group - 1);
+
+    return lower + (1ULL << (group - 1)) - 1;
+  }
+
+  /**
+   * @fn [complete]
+   * 値を記録する
+   */
+  void add(unsigned long long value){
+    bucketCount[bucketOf(value)] += 1;
+    count += 1;
+    maxValue = max(maxValue, value);
+  }
+
+  /**
+   * @fn [complete]
+   * パーセンタイルを返す(バケットの上限値、最大値は超えない)
+   * @param (p) 0.0〜1.0
+   */
+  unsigned long long percentile(double p){
+    if(count == 0) return 0;
+
+    ll rank = max(1LL, (ll)ceil(p * count));
+    ll seen = 0;
+
+    for(int bucket = 0; bucket < HISTOGRAM_SIZE; bucket++){
+      seen += bucketCount[bucket];
+      if(seen >= rank) return min(maxValue, upperBoundOf(bucket));
+    }
+
+    return maxValue;
+  }
+} LOG_LINEAR_HISTOGRAM;
+
+/**
+ * @brief 計測結果
+ *
+ * @detail
+ * 区間の計測はメインスレッドだけで行う。カウンタはロールアウトのスレッドからも数えるのでatomicにする
+ */
+typedef struct profiler {
+  LOG_LINEAR_HISTOGRAM phases[PHASE_COUNT]; // 区間毎のサイクル数
+  atomic<ll> counters[COUNTER_COUNT];       // カウンタ
+
+  profiler(){
+    for(int i = 0; i < COUNTER_COUNT; i++){
+      counters[i] = 0;
+    }
+  }
+
+  /**
+   * @fn [complete]
+   * 計測結果を1行1項目で標準エラーに出力する
+   */
+  void dump(){
+    for(int phase = 0; phase < PHASE_COUNT; phase++){
+      LOG_LINEAR_HISTOGRAM *h = &phases[phase];
+      fprintf(stderr, "PROFILE phase=%s count=%lld p50=%llu p99=%llu max=%llu unit=cycles\n",
+          PHASE_NAMES[phase], h->count, h->percentile(0.50), h->percentile(0.99), h->maxValue);
+    }
+    for(int counter = 0; counter < COUNTER_COUNT; counter++){
+      fprintf(stderr, "PROFILE counter=%s value=%lld\n", COUNTER_NAMES[counter], counters[counter].load());
+    }
+  }
+} PROFILER;
+
+//! 計測結果
+PROFILER g_profiler;
+
+/**
+ * @brief スコープを抜けるまでのサイクル数を区間のヒストグラムに記録する
+ */
+typedef struct profileScopeTimer {
+  int phase;                  // 区間
+  unsigned long long start;   // 開始時のサイクル数
+
+  profileScopeTimer(int phase){
+    this->phase = phase;
+    this->start = readCycleCounter();
+  }
+
+  ~profileScopeTimer(){
+    g_profiler.phases[phase].add(readCycleCounter() - start);
+  }
+} PROFILE_SCOPE_TIMER;
+
+#define PROFILE_SCOPE(phase)        PROFILE_SCOPE_TIMER profileScopeTimer(phase)
+#define PROFILE_COUNT(counter, n)   g_profiler.counters[counter].fetch_add(n, memory_order_relaxed)
+#define PROFILE_DUMP()              g_profiler.dump()
+
+#else
+
+#define PROFILE_SCOPE(phase)
+#define PROFILE_COUNT(counter, n)
+#define PROFILE_DUMP()
+
+#endif
   
 /**
  * @enum Enum 
@@ -90,6 +354,16 @@ enum CellType{
   SPAWN_POINT
 };
 
+/**
+ * @fn [complete]
+ * 経路の種別かどうかを返す
+ * @param (type) Cellの種別
+ * @return 経路かどうかの判定値
+ */
+inline bool isPathType(int type){
+  return type == PATH || type == SPAWN_POINT;
+}
+
 /**
  * @enum Enum
  * 敵の状態を作成
@@ -148,22 +422,6 @@ typedef struct coord {
   }
 } COORD;
 
-/**
- * @brief 経路情報を表す構造体
- */
-typedef struct route {
-  int y;
-  int x;
-  int dist;
-  vector<COORD> routes;
-
-  route(int y = UNDEFINED, int x = UNDEFINED, int dist = UNDEFINED){
-    this->y = y;
-    this->x = x;
-    this->dist = dist;
-  }
-} ROUTE;
-
 /**
  * @brief 建設情報を表す構造体
  */
@@ -212,53 +470,177 @@ int calcRoughDist(int fromY, int fromX, int destY, int destX){
   return (fromY-destY) * (fromY-destY) + (fromX-destX) * (fromX-destX);
 }
 
+/**
+ * @fn [complete]
+ * 座標を1つの整数にまとめる(16bitずつ、SIMDで距離を計算する用)
+ * @param (y) y座標
+ * @param (x) x座標
+ */
+inline int packCoord(int y, int x){
+  return y | (x << 16);
+}
+
+/**
+ * @fn [maybe]
+ * 敵の座標の列から、攻撃範囲内で一番近い敵のIDを返す
+ * @param (pos)     敵の座標 (packCoordでまとめたもの)
+ * @param (ids)     敵ID(posと同じ並び)
+ * @param (count)   敵の数
+ * @param (center)  タワーの座標 (packCoordでまとめたもの)
+ * @param (range2)  攻撃範囲の2乗
+ *
+ * @return 一番近い敵のID(攻撃範囲に居ない場合はNOT_FOUND)
+ * @detail
+ * 距離の2乗とIDを1つの整数(dist << 12 | id)にまとめて最小値を取るので、同じ距離の場合はIDの小さい敵になる。
+ * AVX2では8体、SSE2では4体ずつ計算し、端数は1体ずつ計算する
+ */
+inline int findNearestCreep(const int *pos, const int *ids, int count, int center, int range2){
+  const int INF_KEY = INT_MAX;
+  int bestKey = INF_KEY;
+  int i = 0;
+
+#if defined(__AVX2__)
+  __m256i vCenter = _mm256_set1_epi32(center);
+  __m256i vRange  = _mm256_set1_epi32(range2);
+  __m256i vInf    = _mm256_set1_epi32(INF_KEY);
+  __m256i vBest   = vInf;
+
+  for(; i + 8 <= count; i += 8){
+    // 16bit毎の引き算で(dy, dx)、掛けて隣同士を足せばdy*dy + dx*dx
+    __m256i d     = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*)(pos + i)), vCenter);
+    __m256i dist  = _mm256_madd_epi16(d, d);
+    __m256i key   = _mm256_or_si256(_mm256_slli_epi32(dist, 12), _mm256_loadu_si256((const __m256i*)(ids + i)));
+    __m256i out   = _mm256_cmpgt_epi32(dist, vRange);
+
+    vBest = _mm256_min_epi32(vBest, _mm256_blendv_epi8(key, vInf, out));
+  }
+
+  int lanes[8];
+  _mm256_storeu_si256((__m256i*)lanes, vBest);
+  for(int lane = 0; lane < 8; lane++){
+    bestKey = min(bestKey, lanes[lane]);
+  }
+#elif defined(__SSE2__)
+  __m128i vCenter = _mm_set1_epi32(center);
+  __m128i vRange  = _mm_set1_epi32(range2);
+  __m128i vInf    = _mm_set1_epi32(INF_KEY);
+  __m128i vBest   = vInf;
+
+  for(; i + 4 <= count; i += 4){
+    // 16bit毎の引き算で(dy, dx)、掛けて隣同士を足せばdy*dy + dx*dx
+    __m128i d     = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)(pos + i)), vCenter);
+    __m128i dist  = _mm_madd_epi16(d, d);
+    __m128i key   = _mm_or_si128(_mm_slli_epi32(dist, 12), _mm_loadu_si128((const __m128i*)(ids + i)));
+    __m128i out   = _mm_cmpgt_epi32(dist, vRange);
+    key = _mm_or_si128(_mm_and_si128(out, vInf), _mm_andnot_si128(out, key));
+
+    // SSE2には32bitのminが無いので比較して選ぶ
+    __m128i less = _mm_cmplt_epi32(key, vBest);
+    vBest = _mm_or_si128(_mm_and_si128(less, key), _mm_andnot_si128(less, vBest));
+  }
+
+  int lanes[4];
+  _mm_storeu_si128((__m128i*)lanes, vBest);
+  for(int lane = 0; lane < 4; lane++){
+    bestKey = min(bestKey, lanes[lane]);
+  }
+#endif
+
+  int centerY = center & 0xffff;
+  int centerX = center >> 16;
+
+  for(; i < count; i++){
+    int dist = calcRoughDist(centerY, centerX, pos[i] & 0xffff, pos[i] >> 16);
+
+    if(dist <= range2){
+      bestKey = min(bestKey, (dist << 12) | ids[i]);
+    }
+  }
+
+  return (bestKey == INF_KEY)? NOT_FOUND : (bestKey & 4095);
+}
+
 /**
  * @brief 敵を表す構造体
  */
 typedef struct creep {
   int id;             // ID
-  int originHealth;   // 元の体力
-  int health;         // 体力
-  int y;              // y座標
-  int x;              // x座標
-  int originY;        // ターンに居たY座標
-  int originX;        // ターンに居たX座標
   int created_at;     // 出現時のターン数
   int disappeared_at; // 消失時のターン数
-  int targetBase;     // 狙っている基地
   CreepState state;   // 敵の状態
 
   // 初期化
-  creep(int id = UNDEFINED, int health = UNDEFINED, int y = UNDEFINED, int x = UNDEFINED){
+  creep(int id = UNDEFINED){
     this->id           = id;
-    this->originHealth = health;
-    this->health       = health;
-    this->y            = y;
-    this->x            = x;
-    this->originY      = UNDEFINED;
-    this->originX      = UNDEFINED;
     this->created_at   = UNDEFINED;
     this->state        = ALIVE;
   }
+} CREEP;
+
+/**
+ * @brief 生存中の敵のIDリスト
+ *
+ * @detail
+ * IDを連続した配列で持ち、削除は末尾の要素と入れ替えてO(1)で行う(削除するとIDの順番は崩れる)。
+ * 固定長の配列だけで出来ているので、SIM_STATEに入れたまま複製出来る
+ */
+typedef struct aliveCreepList {
+  int count;          // 生存中の敵の数
+  int ids[MAX_Z];     // 生存中の敵のID
+  int index[MAX_Z];   // idsの中での位置 [creepId]
+
+  aliveCreepList(){
+    this->count = 0;
+  }
 
   /**
    * @fn [complete]
-   * 倒されたかどうかの判定
-   *
-   * @return 倒されたかどうかの判定値
+   * リストを空にする
    */
-  bool isDead(){
-    return health <= 0;
+  void clear(){
+    count = 0;
   }
 
   /**
-   * @fn [not yet]
-   * 生きているかどうかを確認
+   * @fn [complete]
+   * 末尾に敵を追加する
+   * @param (creepId) 敵ID
    */
-  bool isNotDead(){
-    return health > 0;
+  void add(int creepId){
+    index[creepId] = count;
+    ids[count++] = creepId;
   }
-} CREEP;
+
+  /**
+   * @fn [complete]
+   * 敵を削除する(末尾の敵を削除した位置に移す)
+   * @param (creepId) 敵ID
+   */
+  void remove(int creepId){
+    int i = index[creepId];
+    assert(i < count && ids[i] == creepId);
+
+    int lastId = ids[--count];
+    ids[i] = lastId;
+    index[lastId] = i;
+  }
+
+  /**
+   * @fn [complete]
+   * 生存中の敵の数を返す
+   */
+  int size(){
+    return count;
+  }
+
+  /**
+   * @fn [complete]
+   * 空かどうかを返す
+   */
+  bool empty(){
+    return count == 0;
+  }
+} ALIVE_CREEP_LIST;
 
 /*
  * 基地を表す構造体
@@ -364,36 +746,57 @@ typedef struct tower {
   } 
 } TOWER;
 
+/*
+ * マップの各要素の中で毎ターン読み書きする値は、セル単位ではなく値の種類毎の配列で持つ
+ * (周辺のセルを走査する処理で同じ種類の値が連続して並ぶように)
+ */
+
+//! Cellのタイプ
+int g_cellType[MAX_N][MAX_N];
+
+//! 基礎攻撃力
+int g_cellBasicDamage[MAX_N][MAX_N];
+
+//! この場所で与えられる最大ダメージ
+int g_cellDamage[MAX_N][MAX_N];
+
+//! 基礎点
+int g_cellBasicValue[MAX_N][MAX_N];
+
+//! セルの防御価値(値が高い程守る優先度が高い)
+int g_cellDefenseValue[MAX_N][MAX_N];
+
+//! 最短路の経路となっている数
+int g_cellPathCount[MAX_N][MAX_N];
+
+//! 周辺の経路の数
+int g_cellAroundPathCount[MAX_N][MAX_N];
+
 /*
  * @brief マップの各要素を表す構造体
  */
 typedef struct cell {
-  int type;                     //! Cellのタイプ
   int y;                        //! Y座標
   int x;                        //! X座標
-  int basicDamage;              //! 基礎攻撃力
-  int damage;                   //! この場所で与えられる最大ダメージ
   int baseId;                   //! 基地がある場合はそのID
   int spawnId;                  //! スポーン地点の場合はID
-  int basicValue;               //! 基礎点
-  int aroundPathCount;          //! 周辺の経路の数
-  int pathCount;                //! 最短路の経路となっている数
-  int defenseValue;             //! セルの防御価値(値が高い程守る優先度が高い)
-  set<int> basePaths;           //! どの基地の経路になっているかを調べる
-  set<int> spawnPaths;          //! 出現ポイントからの経路になっている
-
-  cell(int y = UNDEFINED, int x = UNDEFINED, int type = UNDEFINED){
+  unsigned short basePaths;     //! どの基地の経路になっているか(baseId番目のビット)
+
+  cell(int y = UNDEFINED, int x = UNDEFINED){
     this->y               = y;
     this->x               = x;
-    this->type            = type;
-    this->basicDamage     = 0;
-    this->damage          = 0;
     this->baseId          = UNDEFINED;
     this->spawnId         = UNDEFINED;
-    this->aroundPathCount = 0;
-    this->pathCount       = 0;
-    this->basicValue      = 0;
-    this->defenseValue    = 0;
+    this->basePaths       = 0;
+  }
+
+  /**
+   * @fn [complete]
+   * Cellのタイプを返す
+   * @return Cellのタイプ
+   */
+  int type(){
+    return g_cellType[y][x];
   }
 
   /**
@@ -402,7 +805,7 @@ typedef struct cell {
    * @return 平地かどうかの判定値
    */
   bool isPlain(){
-    return type == PLAIN;
+    return type() == PLAIN;
   }
 
   /**
@@ -420,7 +823,7 @@ typedef struct cell {
    * @return 基地かどうかの判定値
    */
   bool isBasePoint(){
-    return type == BASE_POINT;
+    return type() == BASE_POINT;
   }
 
   /**
@@ -438,7 +841,7 @@ typedef struct cell {
    * @return スポーン地点かどうかの判定値
    */
   bool isSpawnPoint(){
-    return type == SPAWN_POINT;
+    return type() == SPAWN_POINT;
   }
 
   /**
@@ -447,7 +850,7 @@ typedef struct cell {
    * @return 経路かどうかの判定値
    */
   bool isPath(){
-    return type == PATH || type == SPAWN_POINT;
+    return isPathType(type());
   }
 
 	/**
@@ -456,7 +859,7 @@ typedef struct cell {
 	 * @return タワーかどうかの判定値
 	 */
 	bool isTowerPoint(){
-		return type == TOWER_POINT;
+		return type() == TOWER_POINT;
 	}
 
   /**
@@ -465,7 +868,7 @@ typedef struct cell {
    * @return 進めるCellかどうかの判定値
    */
   bool canMove(){
-    return (type != PLAIN);
+    return (type() != PLAIN);
   }
 } CELL;
 
@@ -481,15 +884,47 @@ int char2int(char ch){
 }
 
 /**
- * @fn [complete]
- * @return 乱数
+ * @brief 乱数生成器(xorshift128)
+ *
+ * @detail
+ * 状態を自分で持つので、スレッド毎・ロールアウト毎に独立した乱数列を作れる
  */
-unsigned long long xor128(){
-  static unsigned long long rx=123456789, ry=362436069, rz=521288629, rw=88675123;
-  unsigned long long rt = (rx ^ (rx<<11));
-  rx=ry; ry=rz; rz=rw;
-  return (rw=(rw^(rw>>19))^(rt^(rt>>8)));
-}
+typedef struct xorShift {
+  unsigned long long rx, ry, rz, rw;
+
+  xorShift(){
+    rx = 123456789; ry = 362436069; rz = 521288629; rw = 88675123;
+  }
+
+  /**
+   * @fn [complete]
+   * 種から状態を作る
+   * @param (seed) 乱数の種
+   *
+   * @detail
+   * 近い種から似た乱数列が出ないように、splitmix64で種を混ぜてから状態に入れる
+   */
+  void setSeed(unsigned long long seed){
+    unsigned long long *state[4] = {&rx, &ry, &rz, &rw};
+
+    for(int i = 0; i < 4; i++){
+      unsigned long long z = (seed += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      *state[i] = z ^ (z >> 31);
+    }
+  }
+
+  /**
+   * @fn [complete]
+   * @return 乱数
+   */
+  unsigned long long next(){
+    unsigned long long rt = (rx ^ (rx<<11));
+    rx=ry; ry=rz; rz=rw;
+    return (rw=(rw^(rw>>19))^(rt^(rt>>8)));
+  }
+} XOR_SHIFT;
 
 
 //! 現在のターン
@@ -528,6 +963,9 @@ int g_realTowerCount;
 //! タワー建設の最小費用
 int g_towerMinCost;
 
+//! 候補となるタワーの最大の攻撃範囲
+int g_towerMaxRange;
+
 //! ボードの横幅
 int g_boardWidth;
 
@@ -557,17 +995,65 @@ BASE g_baseList[MAX_B];
 //! 敵のリスト
 CREEP g_creepList[MAX_Z];
 
-//! 生存中の敵のIDリスト
-set<int> g_aliveCreepsIdList;
-
-//! 一時保存用
-set<int> g_tempAliveCreepsIdList;
-
 //! タワーのリスト
 TOWER g_towerList[MAX_T];
 
-//! ここにタワーを立てることでカバーできる経路の数
-int coverPathCount[MAX_N][MAX_N][MAX_R+1];
+/*
+ * 被覆行列(CSR形式)
+ *   行 = タワーを建てるセル(y*MAX_N+x)、列 = 攻撃範囲に入る経路のセルの番号
+ * 行の中は距離の近い順に並んでいるので、攻撃範囲rの行は先頭からg_coverRowEnd[z][r]までになる
+ */
+
+//! 被覆行列の要素数の上限
+const int MAX_COVER = MAX_N*MAX_N*(2*MAX_R+1)*(2*MAX_R+1);
+
+//! 経路のセルの番号 [y][x] (経路以外はUNDEFINED)
+int g_pathCellIndex[MAX_N][MAX_N];
+
+//! 番号から経路のセルの座標
+COORD g_pathCellList[MAX_N*MAX_N];
+
+//! 経路のセルの数
+int g_pathCellCount;
+
+//! 行の開始位置 [z]
+int g_coverRowStart[MAX_N*MAX_N];
+
+//! 攻撃範囲毎の行の終了位置 [z][range]
+int g_coverRowEnd[MAX_N*MAX_N][MAX_R+1];
+
+//! 列(経路のセルの番号)
+int g_coverColumn[MAX_COVER];
+
+//! 攻撃範囲に入る経路以外のセル(基地、平地、タワー)の数 [z][range]
+int g_coverBlockCount[MAX_N*MAX_N][MAX_R+1];
+
+//! 攻撃範囲に入るセルがマップの外と接している辺の数の合計 [z][range]
+int g_coverEdgeCount[MAX_N*MAX_N][MAX_R+1];
+
+//! 経路のセル毎の評価値のうち攻撃力に依らない部分 [pathCellId]
+int g_coverWeightConst[MAX_N*MAX_N];
+
+//! 経路のセル毎の評価値のうち攻撃力に掛ける部分 [pathCellId]
+int g_coverWeightDamage[MAX_N*MAX_N];
+
+//! セル毎の最も良い建設評価値 [y*MAX_N+x] (建設出来ないセルはINT_MIN)
+int g_buildBestValue[BUILD_TREE_SIZE];
+
+//! セル毎の最も良い建設評価値のタワーの種別 [y*MAX_N+x]
+int g_buildBestType[BUILD_TREE_SIZE];
+
+//! 最も良い建設評価値を持つセルを管理するセグメント木(同じ値の場合は番号の小さいセル)
+int g_buildValueTree[2*BUILD_TREE_SIZE];
+
+//! 評価値に関わる値が変化したセルのフラグ
+bool g_dirtyCellFlag[MAX_N][MAX_N];
+
+//! 評価値に関わる値が変化したセルのリスト
+COORD g_dirtyCellList[MAX_N*MAX_N];
+
+//! 評価値に関わる値が変化したセルの数
+int g_dirtyCellCount;
 
 //! 建設済みのタワーリスト
 vector<TOWER> g_buildedTowerList;
@@ -581,8 +1067,52 @@ vector<SPAWN> g_spawnList;
 //! スポーン地点の数
 int g_spawnCount;
 
-//! 前に行動したstepを覚える配列
-int g_prevStep[MAX_N][MAX_N];
+/*
+ * 基地毎の距離場
+ */
+
+//! 基地までの歩数 [baseId][y][x] (その基地に辿り着けないセルはUNDEFINED)
+int g_baseDist[MAX_B][MAX_N][MAX_N];
+
+//! 基地への最短路になる方向の中で番号が一番小さい方向 [baseId][y][x]
+int g_baseShortestDir[MAX_B][MAX_N][MAX_N];
+
+//! 経路のあるセルを基地までの歩数の近い順に並べたもの [baseId][i]
+COORD g_baseRouteOrder[MAX_B][MAX_N*MAX_N];
+
+//! g_baseRouteOrderのセルの数 [baseId]
+int g_baseRouteOrderCount[MAX_B];
+
+//! 基地に向かう敵がこのセルの次から続けて進む、タワーの攻撃が届かないセルの数 [baseId][y][x]
+int g_corridorLength[MAX_B][MAX_N][MAX_N];
+
+//! 攻撃の届かないセルが続く区間の最後のセル(packCoord、続かない場合はこのセル自身) [baseId][y][x]
+int g_corridorExit[MAX_B][MAX_N][MAX_N];
+
+//! 基地に向かう敵がこのセルの次から基地に着くまでに受ける攻撃力の合計(狙われるのがこの敵だけの場合) [baseId][y][x]
+int g_routeDamage[MAX_B][MAX_N][MAX_N];
+
+/*
+ * 幅優先探索の作業用の配列(初期化の計算を分担するスレッドでも使うので、スレッド毎に持つ)
+ */
+
+//! 幅優先探索の訪問済みリスト(値が現在の探索番号と一致していれば訪問済み)
+thread_local int g_checkList[MAX_N][MAX_N];
+
+//! 幅優先探索の探索番号
+thread_local int g_checkListId;
+
+//! 幅優先探索で使用するキュー(各セルは高々1回しか入らないのでMAX_N*MAX_Nで足りる)
+thread_local COORD g_bfsQueue[MAX_N*MAX_N];
+
+//! 攻撃範囲毎の円盤状の相対座標リスト(距離の近い順) [range][i] - (dy, dx, 距離の2乗)
+COORD g_discKernel[MAX_R+1][(2*MAX_R+1)*(2*MAX_R+1)];
+
+//! 攻撃範囲毎の相対座標の数
+int g_discKernelSize[MAX_R+1];
+
+//! 基地から各セルまでrange歩以内で到達する歩き方の数 [baseId][range][dy][dx]
+int g_baseWalkCount[MAX_B][MAX_R+1][2*MAX_R+1][2*MAX_R+1];
 
 /**
  * @fn [complete]
@@ -610,12 +1140,804 @@ int calcManhattanDist(int fromY, int fromX, int destY, int destX){
   return abs(fromY-destY) + abs(fromX-destX);
 }
 
-class PathDefense{
-  public:
-    vector<int> m_buildTowerData;
+/**
+ * @fn [complete]
+ * 画面外に出ていないかをチェック
+ * @param (y) Y座標
+ * @param (x) X座標
+ *
+ * @return マップから出ているかどうかを返す
+ */
+inline bool isOutsideMap(int y, int x){
+  return (y < 0 || x < 0 || y >= g_boardHeight || x >= g_boardWidth);
+}
 
-    /**
-     * @fn
+/* 
+ * @brief シミュレーション用のタワーを表す構造体
+ */
+typedef struct simTower {
+  int y;        // y座標
+  int x;        // x座標
+  int range;    // 射程距離
+  int damage;   // 攻撃力
+} SIM_TOWER;
+
+/**
+ * @brief 先読みシミュレーションの盤面状態
+ *
+ * @detail
+ * 敵・タワー・基地の体力・セルの攻撃力を固定長の配列だけで持つので、そのままコピー出来る。
+ * 先読みは観測した状態(g_simState)をfork()で複製した上で進め、観測した状態自体は書き換えない。
+ * 盤面の地形と最短路(g_cellType, g_shortestPathMap等)は読むだけなので、別スレッドから同時に進めても良い
+ */
+typedef struct simState {
+  ALIVE_CREEP_LIST alive;                 // 生存中の敵のIDリスト
+  int alivePos[MAX_Z];                    // 生存中の敵の座標(packCoord) [aliveのidsと同じ並び]
+  int creepHp[MAX_Z];                     // 体力 [creepId]
+  int creepY[MAX_Z];                      // y座標 [creepId]
+  int creepX[MAX_Z];                      // x座標 [creepId]
+  int creepTargetBase[MAX_Z];             // 狙っている基地 [creepId] (ロールアウト毎に決める)
+  int creepSleepStep[MAX_Z];              // 攻撃の届かない区間に入ったステップ [creepId]
+  int creepWakeStep[MAX_Z];               // 区間を抜けて動き出すステップ(stepCount以下なら毎ステップ動く) [creepId]
+  int cellCreepHead[MAX_N][MAX_N];        // セル毎の敵のリストの先頭の敵ID(居ない場合はNOT_FOUND)
+  int creepNextInCell[MAX_Z];             // 同じセルにいる次の敵のID
+  int creepPrevInCell[MAX_Z];             // 同じセルにいる前の敵のID
+  int baseHealth[MAX_B];                  // 基地の体力
+  int towerCount;                         // タワーの数
+  SIM_TOWER towers[MAX_N*MAX_N];          // タワーのリスト(建設順 = 攻撃順)
+  int cellDamage[MAX_N][MAX_N];           // セルに届くタワーの攻撃力の合計
+  int stepCount;                          // 複製してから進めたステップの数
+  int awakeCount;                         // 直前のステップの後も毎ステップ動く敵の数
+  int exposedCount;                       // 直前のステップで攻撃の届くセルに入った敵の数
+
+  simState(){
+    this->towerCount    = 0;
+    this->stepCount     = 0;
+    this->awakeCount    = 0;
+    this->exposedCount  = 0;
+  }
+
+  /**
+   * @fn [complete]
+   * 状態を複製する
+   * @param (child) 複製先
+   *
+   * @detail
+   * 生存中の敵と建設済みのタワーの分だけをコピーするので、丸ごと代入するより軽い
+   */
+  void fork(simState *child) const {
+    int aliveCount = alive.count;
+
+    child->alive.count = aliveCount;
+    for(int i = 0; i < aliveCount; i++){
+      int creepId = alive.ids[i];
+
+      child->alive.ids[i]                = creepId;
+      child->alive.index[creepId]        = i;
+      child->alivePos[i]                 = alivePos[i];
+      child->creepHp[creepId]            = creepHp[creepId];
+      child->creepY[creepId]             = creepY[creepId];
+      child->creepX[creepId]             = creepX[creepId];
+      child->creepTargetBase[creepId]    = creepTargetBase[creepId];
+      child->creepSleepStep[creepId]     = creepSleepStep[creepId];
+      child->creepWakeStep[creepId]      = creepWakeStep[creepId];
+      child->creepNextInCell[creepId]    = creepNextInCell[creepId];
+      child->creepPrevInCell[creepId]    = creepPrevInCell[creepId];
+    }
+
+    memcpy(child->cellCreepHead, cellCreepHead, sizeof(cellCreepHead));
+    memcpy(child->baseHealth, baseHealth, sizeof(baseHealth));
+    memcpy(child->cellDamage, cellDamage, sizeof(cellDamage));
+
+    child->towerCount = towerCount;
+    memcpy(child->towers, towers, towerCount * sizeof(SIM_TOWER));
+    child->stepCount = stepCount;
+
+    // 複製した直後は全ての敵が動くものとして扱う
+    child->awakeCount = aliveCount;
+    child->exposedCount = aliveCount;
+  }
+
+  /**
+   * @fn [complete]
+   * 複製元の状態に戻す
+   * @param (origin) 複製元の状態
+   */
+  void restore(const simState &origin){
+    origin.fork(this);
+  }
+
+  /**
+   * @fn [complete]
+   * 倒されたかどうかの判定
+   * @param (creepId) 敵ID
+   *
+   * @return 倒されたかどうかの判定値
+   */
+  bool isDead(int creepId){
+    return creepHp[creepId] <= 0;
+  }
+
+  /**
+   * @fn [complete]
+   * 敵を追加する
+   * @param (creepId) 敵ID
+   * @param (hp)      体力
+   * @param (y)       Y座標
+   * @param (x)       X座標
+   *
+   * @detail
+   * セル毎の敵のリストは追加が終わった後にrebuildCellCreepListで作る
+   */
+  void addCreep(int creepId, int hp, int y, int x){
+    creepHp[creepId]          = hp;
+    creepY[creepId]           = y;
+    creepX[creepId]           = x;
+    creepTargetBase[creepId]  = UNDEFINED;
+    creepSleepStep[creepId]   = 0;
+    creepWakeStep[creepId]    = 0;
+    alivePos[alive.count]     = packCoord(y, x);
+    alive.add(creepId);
+  }
+
+  /**
+   * @fn [maybe]
+   * 生存中の全ての敵の狙う基地をランダムに決める
+   * @param (rng) 乱数生成器
+   *
+   * @detail
+   * 今いるセルから最短路で向かえる基地の中から等確率で選ぶ
+   */
+  void sampleTargetBases(XOR_SHIFT *rng){
+    int aliveCount = alive.count;
+
+    for(int i = 0; i < aliveCount; i++){
+      int creepId = alive.ids[i];
+      unsigned int mask = g_board[creepY[creepId]][creepX[creepId]].basePaths;
+
+      // 候補の中からk番目に小さい基地IDを選ぶ
+      int k = rng->next() % __builtin_popcount(mask);
+      while(k--){
+        mask &= mask - 1;
+      }
+
+      creepTargetBase[creepId] = __builtin_ctz(mask);
+    }
+  }
+
+  /**
+   * @fn [complete]
+   * タワーを追加する
+   * @param (y)      Y座標
+   * @param (x)      X座標
+   * @param (range)  射程距離
+   * @param (damage) 攻撃力
+   */
+  void addTower(int y, int x, int range, int damage){
+    assert(towerCount < MAX_N*MAX_N);
+
+    SIM_TOWER *tower = &towers[towerCount++];
+    tower->y      = y;
+    tower->x      = x;
+    tower->range  = range;
+    tower->damage = damage;
+
+    const COORD *kernel = g_discKernel[range];
+    int size = g_discKernelSize[range];
+
+    for(int i = 0; i < size; i++){
+      int ny = y + kernel[i].y;
+      int nx = x + kernel[i].x;
+
+      if(isOutsideMap(ny, nx)) continue;
+
+      cellDamage[ny][nx] += damage;
+    }
+  }
+
+  /**
+   * @fn [maybe]
+   * 1ターン進める
+   * @param (onMove) 敵が移動した時に呼ぶ関数 (creepId, y, x)
+   * @param (onSkip) 攻撃の届かない区間をまとめて進んだ時に呼ぶ関数 (creepId, y, x, length)
+   *                 (y, x)から狙っている基地に向けてlength歩進んだことを表す
+   *
+   * @return 基地に到達した敵が居た場合はその基地のID(複数の敵が到達している場合はIDの一番小さい敵の基地)
+   * @detail
+   * 敵の移動 → 基地への到達 → タワーの攻撃の順で処理する。
+   * 基地に到達した敵は基地の体力を削って消える。
+   * 攻撃の届くセルに居る敵が居ない場合は、どのタワーも攻撃出来ないので攻撃の処理を省く
+   */
+  template<class ON_MOVE, class ON_SKIP>
+  int step(ON_MOVE onMove, ON_SKIP onSkip){
+    moveCreeps(onMove, onSkip);
+
+    int reachBaseId = reachBases();
+
+    if(exposedCount > 0){
+      PROFILE_COUNT(COUNTER_ATTACK_STEPS, 1);
+      attackTowers();
+    }
+
+    return reachBaseId;
+  }
+
+  /**
+   * @fn [maybe]
+   * 次に何かが起きるまでの何も起きないステップの数を返す
+   *
+   * @return 何も起きないステップの数
+   * @detail
+   * 全ての敵が攻撃の届かない区間を進んでいる途中なら、誰かが区間を抜けるまでは
+   * 移動・基地への到達・タワーの攻撃のどれも起きない(区間を抜けると、攻撃の届くセルか基地に入る)
+   */
+  int idleStepCount(){
+    if(awakeCount > 0 || alive.empty()) return 0;
+
+    int nextStep = INT_MAX;
+    int aliveCount = alive.count;
+
+    for(int i = 0; i < aliveCount; i++){
+      nextStep = min(nextStep, creepWakeStep[alive.ids[i]]);
+    }
+
+    return nextStep - stepCount - 1;
+  }
+
+  /**
+   * @fn [complete]
+   * 何も起きないステップを飛ばす
+   * @param (count) 飛ばすステップの数(idleStepCount以下)
+   */
+  void skipIdleSteps(int count){
+    PROFILE_COUNT(COUNTER_IDLE_STEPS, count);
+    stepCount += count;
+  }
+
+  /**
+   * @fn [maybe]
+   * 生存中の全ての敵を狙っている基地に向けて1歩動かす
+   * @param (onMove) 敵が移動した時に呼ぶ関数 (creepId, y, x)
+   * @param (onSkip) 攻撃の届かない区間をまとめて進んだ時に呼ぶ関数 (creepId, y, x, length)
+   *
+   * @detail
+   * 攻撃の届かないセルに入った敵は、その先に続く攻撃の届かない区間(g_corridorLength)を抜けるまで動かさない。
+   * 区間を抜けるステップで区間の最後のセル(g_corridorExit)に移してから1歩動かす。
+   * 止めている間の座標は攻撃の届かないセルのままなので、どのタワーにも狙われない
+   */
+  template<class ON_MOVE, class ON_SKIP>
+  void moveCreeps(ON_MOVE onMove, ON_SKIP onSkip){
+    int aliveCount = alive.count;
+    int step = ++stepCount;
+
+    awakeCount = 0;
+    exposedCount = 0;
+
+    for(int i = 0; i < aliveCount; i++){
+      int creepId = alive.ids[i];
+      int wakeStep = creepWakeStep[creepId];
+
+      // 攻撃の届かない区間を進んでいる途中
+      if(wakeStep > step) continue;
+      PROFILE_COUNT(COUNTER_CREEP_STEPS, 1);
+
+      int y = creepY[creepId];
+      int x = creepX[creepId];
+      int baseId = creepTargetBase[creepId];
+
+      // 区間を抜けるので、区間の最後のセルまでまとめて進める
+      if(wakeStep == step){
+        int exitPos = g_corridorExit[baseId][y][x];
+        onSkip(creepId, y, x, step - 1 - creepSleepStep[creepId]);
+
+        y = exitPos & 0xFFFF;
+        x = exitPos >> 16;
+      }
+
+      int direct = g_shortestPathMap[y][x][baseId];
+      assert(direct != UNDEFINED);
+      y += DY[direct];
+      x += DX[direct];
+
+      // セル毎の敵のリストも移動させる
+      removeCreepFromCell(creepId);
+      creepY[creepId] = y;
+      creepX[creepId] = x;
+      alivePos[i] = packCoord(y, x);
+      addCreepToCell(creepId);
+
+      assert(!isOutsideMap(y, x));
+      onMove(creepId, y, x);
+
+      // 攻撃の届かないセルが続く場合は、区間を抜けるまで止める
+      if(cellDamage[y][x] > 0){
+        exposedCount++;
+        awakeCount++;
+      }else if(g_cellType[y][x] != BASE_POINT && g_corridorLength[baseId][y][x] > 0){
+        creepSleepStep[creepId] = step;
+        creepWakeStep[creepId] = step + g_corridorLength[baseId][y][x] + 1;
+      }else{
+        awakeCount++;
+      }
+    }
+  }
+
+  /**
+   * @fn [maybe]
+   * 攻撃の届かない区間を進んでいる途中の敵について、ここまでに進んだ分を知らせる
+   * @param (onSkip) 進んだ分を知らせる関数 (creepId, y, x, length)
+   *
+   * @detail
+   * 区間を抜ける前に途中までの経路が必要になった時に呼ぶ(区間を抜ける時には改めて区間の全体を知らせる)
+   */
+  template<class ON_SKIP>
+  void visitSleepingCreeps(ON_SKIP onSkip){
+    int aliveCount = alive.count;
+
+    for(int i = 0; i < aliveCount; i++){
+      int creepId = alive.ids[i];
+
+      if(creepWakeStep[creepId] > stepCount){
+        onSkip(creepId, creepY[creepId], creepX[creepId], stepCount - creepSleepStep[creepId]);
+      }
+    }
+  }
+
+  /**
+   * @fn [maybe]
+   * 基地に到達した敵を処理する
+   *
+   * @return 到達した基地のID(複数の敵が到達している場合はIDの一番小さい敵の基地)
+   */
+  int reachBases(){
+    int reachBaseId = NOT_REACH;
+    int reachCreepId = NOT_FOUND;
+
+    // 末尾から処理すれば削除で入れ替わる敵は処理済みのものだけになる
+    for(int i = alive.count-1; i >= 0; i--){
+      int creepId = alive.ids[i];
+      int y = creepY[creepId];
+      int x = creepX[creepId];
+
+      if(g_cellType[y][x] != BASE_POINT) continue;
+
+      int baseId = g_board[y][x].baseId;
+
+      if(reachCreepId == NOT_FOUND || reachCreepId > creepId){
+        reachCreepId = creepId;
+        reachBaseId = baseId;
+      }
+
+      baseHealth[baseId] = max(0, baseHealth[baseId] - creepHp[creepId]);
+      removeCreep(creepId);
+    }
+
+    return reachBaseId;
+  }
+
+  /**
+   * @fn [maybe]
+   * 全てのタワーが一番近い敵を攻撃する
+   */
+  void attackTowers(){
+    for(int towerId = 0; towerId < towerCount && alive.count > 0; towerId++){
+      SIM_TOWER *tower = &towers[towerId];
+
+      int creepId = searchMostNearCreepId(tower);
+
+      if(creepId != NOT_FOUND){
+        attack(creepId, tower->damage);
+      }
+    }
+  }
+
+  /**
+   * @fn [complete]
+   * 敵に対して攻撃を行う
+   * @param (creepId) 敵ID
+   * @param (damage)  攻撃力
+   */
+  void attack(int creepId, int damage){
+    creepHp[creepId] -= damage;
+
+    // もしHPが0以下の場合は倒した
+    if(isDead(creepId)){
+      removeCreep(creepId);
+    }
+  }
+
+  /**
+   * @fn [complete]
+   * 敵を盤面から取り除く
+   * @param (creepId) 敵ID
+   */
+  void removeCreep(int creepId){
+    // aliveと同じく末尾の敵を削除した位置に移す
+    alivePos[alive.index[creepId]] = alivePos[alive.count-1];
+    alive.remove(creepId);
+    removeCreepFromCell(creepId);
+  }
+
+  /**
+   * @fn [maybe]
+   * タワーから生存中の敵で一番近い敵のIDを返す
+   * @param (tower) タワー情報
+   *
+   * @return 一番近い敵のID
+   * @detail
+   * 同じ距離の敵が複数いる場合はIDの小さい敵を選ぶ
+   * 生存中の敵が攻撃範囲のセル数の2倍より多い場合は、攻撃範囲のセルを近い順に調べる
+   * (敵の列はSIMDでまとめて調べるので、セル数と同じくらいまでは列を調べる方が速い)
+   */
+  int searchMostNearCreepId(const SIM_TOWER *tower){
+    if(alive.count > 2 * g_discKernelSize[tower->range]){
+      return searchMostNearCreepIdByCell(tower);
+    }
+
+    // 生存中の敵をまとめて処理
+    return findNearestCreep(alivePos, alive.ids, alive.count, packCoord(tower->y, tower->x), tower->range * tower->range);
+  }
+
+  /**
+   * @fn [maybe]
+   * 攻撃範囲のセルを近い順に調べて、一番近い敵のIDを返す
+   * @param (tower) タワー情報
+   *
+   * @return 一番近い敵のID
+   * @detail
+   * 敵が見つかった距離と同じ距離のセルまでは調べて、その中でIDの一番小さい敵を選ぶ
+   */
+  int searchMostNearCreepIdByCell(const SIM_TOWER *tower){
+    int mostNearCreepId = NOT_FOUND;
+    int minDist = INT_MAX;
+    const COORD *kernel = g_discKernel[tower->range];
+    int size = g_discKernelSize[tower->range];
+
+    for(int i = 0; i < size; i++){
+      // 見つかった距離より遠いセルは調べない
+      if(kernel[i].dist > minDist) break;
+
+      int y = tower->y + kernel[i].y;
+      int x = tower->x + kernel[i].x;
+
+      if(isOutsideMap(y, x)) continue;
+
+      for(int creepId = cellCreepHead[y][x]; creepId != NOT_FOUND; creepId = creepNextInCell[creepId]){
+        if(mostNearCreepId == NOT_FOUND || mostNearCreepId > creepId){
+          assert(!isDead(creepId));
+          minDist = kernel[i].dist;
+          mostNearCreepId = creepId;
+        }
+      }
+    }
+
+    return mostNearCreepId;
+  }
+
+  /**
+   * @fn [maybe]
+   * セル毎の敵のリストを生存中の敵から作り直す
+   */
+  void rebuildCellCreepList(){
+    memset(cellCreepHead, NOT_FOUND, sizeof(cellCreepHead));
+
+    int aliveCount = alive.count;
+
+    for(int i = 0; i < aliveCount; i++){
+      addCreepToCell(alive.ids[i]);
+    }
+  }
+
+  /**
+   * @fn [complete]
+   * 敵を今いるセルのリストに追加する
+   * @param (creepId) 敵ID
+   */
+  void addCreepToCell(int creepId){
+    int y = creepY[creepId];
+    int x = creepX[creepId];
+    int head = cellCreepHead[y][x];
+
+    creepPrevInCell[creepId] = NOT_FOUND;
+    creepNextInCell[creepId] = head;
+    if(head != NOT_FOUND) creepPrevInCell[head] = creepId;
+    cellCreepHead[y][x] = creepId;
+  }
+
+  /**
+   * @fn [complete]
+   * 敵を今いるセルのリストから削除する
+   * @param (creepId) 敵ID
+   */
+  void removeCreepFromCell(int creepId){
+    int prev = creepPrevInCell[creepId];
+    int next = creepNextInCell[creepId];
+
+    if(prev != NOT_FOUND){
+      creepNextInCell[prev] = next;
+    }else{
+      assert(cellCreepHead[creepY[creepId]][creepX[creepId]] == creepId);
+      cellCreepHead[creepY[creepId]][creepX[creepId]] = next;
+    }
+    if(next != NOT_FOUND) creepPrevInCell[next] = prev;
+  }
+} SIM_STATE;
+
+//! 観測した盤面の状態(毎ターンの入力で更新する)
+SIM_STATE g_simState;
+
+/**
+ * @brief ロールアウト1回分の結果
+ */
+typedef struct rolloutResult {
+  int reachBaseId;    // 最初に敵が到達した基地のID(到達しなかった場合はNOT_REACH)
+  int damage[MAX_B];  // 先読みの間に各基地が受けたダメージ
+} ROLLOUT_RESULT;
+
+/**
+ * @brief ロールアウトの結果を基地毎にまとめたもの
+ */
+typedef struct threatInfo {
+  int rolloutCount;                 // ロールアウトの回数
+  int reachCount;                   // いずれかの基地に到達されたロールアウトの数
+  double breachProbability[MAX_B];  // 最初に到達される基地がその基地である確率
+  double expectedDamage[MAX_B];     // 先読みの間に受けるダメージの期待値
+  int nearCreepCount;               // 先読みの間に基地に着く可能性のある敵の数(距離場での判定)
+} THREAT_INFO;
+
+/**
+ * @brief ロールアウトを行うスレッド毎の作業領域
+ *
+ * @detail
+ * 盤面の複製と防御価値の足し込み先をスレッド毎に持つので、ロールアウト同士は何も共有しない
+ */
+typedef struct rolloutWorker {
+  SIM_STATE state;                        // 先読みに使う盤面の状態
+  int rolloutDefenseValue[MAX_N][MAX_N];  // 実行中のロールアウトで敵が通ったセルの防御価値
+  ll defenseValue[MAX_N][MAX_N];          // 基地に到達されたロールアウトの防御価値の合計
+} ROLLOUT_WORKER;
+
+/**
+ * @brief ロールアウトを並列に実行するスレッドプール
+ *
+ * @detail
+ * 呼び出したスレッドも0番目のスレッドとして仕事をする。
+ * 仕事はatomicなカウンタで配るので、どのスレッドがどの仕事をするかは毎回変わる。
+ * 仕事の番号毎に結果を書けば、スレッドの数や実行順によらず同じ結果になる
+ */
+typedef struct rolloutPool {
+  vector<thread> threads;           // 呼び出し元以外のスレッド
+  mutex mtx;                        // 以下の変数を守る
+  condition_variable wakeUp;        // 仕事が来たことの通知
+  condition_variable finished;      // 仕事が終わったことの通知
+  function<void(int, int)> job;     // 実行する仕事 (threadId, taskId)
+  int taskCount;                    // 仕事の数
+  atomic<int> nextTaskId;           // 次に配る仕事の番号
+  int generation;                   // 何回目の仕事か
+  int runningCount;                 // 仕事中のスレッドの数
+  bool quit;                        // 終了フラグ
+
+  rolloutPool(){
+    this->taskCount     = 0;
+    this->nextTaskId    = 0;
+    this->generation    = 0;
+    this->runningCount  = 0;
+    this->quit          = false;
+  }
+
+  ~rolloutPool(){
+    stop();
+  }
+
+  /**
+   * @fn [complete]
+   * 呼び出し元も含めたスレッドの数を返す
+   */
+  int size(){
+    return threads.size() + 1;
+  }
+
+  /**
+   * @fn [complete]
+   * スレッドを起動する
+   * @param (threadCount) 呼び出し元も含めたスレッドの数
+   */
+  void start(int threadCount){
+    for(int threadId = 1; threadId < threadCount; threadId++){
+      threads.push_back(thread([this, threadId](){ workerLoop(threadId); }));
+    }
+  }
+
+  /**
+   * @fn [complete]
+   * スレッドを終了させる
+   */
+  void stop(){
+    {
+      lock_guard<mutex> lock(mtx);
+      quit = true;
+    }
+    wakeUp.notify_all();
+
+    for(int i = 0; i < threads.size(); i++){
+      threads[i].join();
+    }
+    threads.clear();
+  }
+
+  /**
+   * @fn [complete]
+   * 仕事を全てのスレッドで分担して実行し、全て終わるまで待つ
+   * @param (count) 仕事の数
+   * @param (work)  仕事 void(int threadId, int taskId)
+   */
+  void run(int count, function<void(int, int)> work){
+    {
+      lock_guard<mutex> lock(mtx);
+      job           = work;
+      taskCount     = count;
+      nextTaskId    = 0;
+      runningCount  = threads.size();
+      generation   += 1;
+    }
+    wakeUp.notify_all();
+
+    doTasks(0);
+
+    unique_lock<mutex> lock(mtx);
+    finished.wait(lock, [this](){ return runningCount == 0; });
+  }
+
+  /**
+   * @fn [complete]
+   * 残っている仕事を取って実行する
+   * @param (threadId) スレッドID
+   */
+  void doTasks(int threadId){
+    for(int taskId = nextTaskId++; taskId < taskCount; taskId = nextTaskId++){
+      job(threadId, taskId);
+    }
+  }
+
+  /**
+   * @fn [complete]
+   * 呼び出し元以外のスレッドの処理(仕事が来るまで眠る)
+   * @param (threadId) スレッドID
+   */
+  void workerLoop(int threadId){
+    int doneGeneration = 0;
+
+    while(true){
+      {
+        unique_lock<mutex> lock(mtx);
+        wakeUp.wait(lock, [&](){ return quit || generation != doneGeneration; });
+        if(quit) return;
+        doneGeneration = generation;
+      }
+
+      doTasks(threadId);
+
+      {
+        lock_guard<mutex> lock(mtx);
+        runningCount -= 1;
+      }
+      finished.notify_one();
+    }
+  }
+} ROLLOUT_POOL;
+
+//! ロールアウト用のスレッドプール
+ROLLOUT_POOL g_rolloutPool;
+
+//! スレッド毎の作業領域 [threadId]
+vector<ROLLOUT_WORKER> g_rolloutWorkers;
+
+//! 今までに行ったロールアウトの呼び出し回数(乱数の種に使う)
+int g_rolloutSerial;
+
+//! 残りのロールアウトを打ち切る(ターンの合間の先読みを止める時に立てる)
+atomic<bool> g_cancelRollouts;
+
+/**
+ * @brief ターンの合間に行う、次のターンの危険度の先読み(-speculate を付けた時だけ行う)
+ *
+ * @detail
+ * 入力を待っている間に、敵が最短路を1歩進んだ盤面を予想して、次のターンの最初の段階の評価を済ませておく。
+ * 次のターンの盤面が予想と完全に一致し、同じターン・ロールアウトの通し番号・回数・先読みのターン数で
+ * 評価する場合だけ結果を使うので、使っても使わなくても結果は変わらない
+ */
+typedef struct speculation {
+  bool enabled;                     // 先読みを行うかどうか
+  thread worker;                    // 先読みを行うスレッド
+  bool ready;                       // 結果が使えるかどうか
+  int turn;                         // 評価したターン
+  int rolloutSerial;                // 評価に使ったロールアウトの通し番号
+  int rolloutCount;                 // ロールアウトの回数
+  int horizon;                      // 先読みするターン数
+  SIM_STATE state;                  // 予想した盤面
+  THREAT_INFO threat;               // 評価の結果
+  int baseId;                       // 一番危ない基地のID
+  double cost;                      // 評価にかかった時間(ms)
+  ll defenseValue[MAX_N][MAX_N];    // 基地に到達されたロールアウトの防御価値の合計(全てのスレッドの分)
+  int hitCount;                     // 結果を使えた回数
+  int missCount;                    // 予想が外れた回数
+} SPECULATION;
+
+//! ターンの合間の先読み
+SPECULATION g_speculation;
+
+/**
+ * @brief 探索に使う時間の管理
+ *
+ * @detail
+ * ソルバーの中で使った時間を積算し、残り時間を残りターン数で均等に割った値を基準に各ターンの持ち時間を決める。
+ * 敵の少ないターンで使わなかった時間は残り時間に残るので、後の敵の多いターンで使える
+ */
+typedef struct searchBudget {
+  chrono::steady_clock::time_point startTime; // 計測を始めた時刻
+  double usedTime;                            // これまでに使った時間(ms)
+  double turnBudget;                          // このターンに使って良い時間(ms)
+
+  searchBudget(){
+    this->usedTime    = 0.0;
+    this->turnBudget  = 0.0;
+  }
+
+  /**
+   * @fn [complete]
+   * 計測を始める
+   */
+  void start(){
+    startTime = chrono::steady_clock::now();
+  }
+
+  /**
+   * @fn [complete]
+   * 計測を終えて使った時間に足す
+   */
+  void stop(){
+    usedTime += elapsed();
+  }
+
+  /**
+   * @fn [complete]
+   * 計測を始めてからの時間(ms)を返す
+   */
+  double elapsed(){
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+  }
+
+  /**
+   * @fn [complete]
+   * このターンの持ち時間を決める
+   * @param (remainingTurn) このターンを含めた残りのターン数
+   */
+  void allocate(int remainingTurn){
+    double remainingTime = max(0.0, TIME_LIMIT - usedTime);
+
+    turnBudget = min(remainingTime, BURST_RATE * remainingTime / max(1, remainingTurn));
+  }
+
+  /**
+   * @fn [complete]
+   * このターンの持ち時間の中で、まだcostの処理を行えるかどうか
+   * @param (cost) 処理にかかる時間の見積もり(ms)
+   */
+  bool canAfford(double cost){
+    return elapsed() + cost <= turnBudget;
+  }
+} SEARCH_BUDGET;
+
+//! 探索に使う時間
+SEARCH_BUDGET g_searchBudget;
+
+
+class PathDefense{
+  public:
+    vector<int> m_buildTowerData;
+
+    /**
+     * @fn
      * 初期化関数
      * @param (board)       ボード情報
      * @param (money)       初期所持金
@@ -623,507 +1945,1382 @@ class PathDefense{
      * @param (creepMoney)  敵を倒した時に得られるお金
      *
      * @detail
-     * ゲームを始めるにあたって必要な情報を初期化しておく
+     * ゲームを始めるにあたって必要な情報を初期化しておく
+     */
+    int init(const vector<string> &board, int money, int creepHealth, int creepMoney, const vector<int> &towerTypes){
+      fprintf(stderr,"init =>\n");
+      g_searchBudget.start();
+
+      // ターンを初期化を行う
+      g_currentTurn = 0;
+
+			// このゲームを諦める
+			g_giveup = true;
+
+      // 出現した敵の総数を初期化
+      g_totalCreepCount = 0;
+
+      // 基地の数を初期化
+      g_baseCount = 0;
+
+      // 最短路マップの初期化
+      memset(g_shortestPathMap, UNDEFINED, sizeof(g_shortestPathMap));
+      memset(g_baseShortestDir, UNDEFINED, sizeof(g_baseShortestDir));
+
+      // 基地までの歩数の初期化
+      memset(g_baseDist, UNDEFINED, sizeof(g_baseDist));
+
+      // 基地に着くまでに受ける攻撃力の合計の初期化(タワーが無いので0)
+      memset(g_routeDamage, 0, sizeof(g_routeDamage));
+
+      // 幅優先探索の訪問済みリストの初期化
+      memset(g_checkList, 0, sizeof(g_checkList));
+      g_checkListId = 0;
+
+			// 狙われ安さの初期化
+			memset(g_targetedBasePoint, 0, sizeof(g_targetedBasePoint));
+
+      // 敵の初期体力の初期化
+      g_creepHealth = creepHealth;
+
+      // 攻撃範囲の相対座標リストを作成
+      initDiscKernel();
+
+      // ロールアウト用のスレッドを用意(初期化の計算の分担にも使う)
+      initRolloutPool();
+
+      // ボードの初期化を行う
+      initBoardData(board);
+
+      // タワーの初期化を行う
+      initTowerData(towerTypes);
+
+      // 基地毎の距離場と、基地までの最短路を計算
+      initCellToBaseShortestPath();
+
+      // 初期の所持金
+      g_currentAmountMoney = money;
+
+      // 建設したタワーの数を初期化
+      g_buildedTowerCount = 0;
+
+      // 報酬の初期化
+      g_reward = creepMoney;
+
+      // セルの防御価値を初期化
+      initCellBasicValue();
+
+      // 建設評価値のキャッシュを初期化
+      initBuildValueCache();
+
+      // ゲーム情報の表示
+      showGameData();
+
+      g_searchBudget.stop();
+      
+      return 0;
+    }
+
+    /**
+     * @fn [maybe]
+     * ゲームの基礎情報を表示
+     *   - 敵の基礎体力
+     *   - 敵を倒した時の報酬
+     */
+    void showGameData(){
+      fprintf(stderr,"-----------------------------------------------\n");
+			fprintf(stderr,"Tower count = %d\n", g_realTowerCount);
+			fprintf(stderr,"Base count = %d\n", g_baseCount);
+      fprintf(stderr,"BoardSize = Y: %d, X: %d\n", g_boardHeight, g_boardWidth);
+      fprintf(stderr,"creepHealth = %d\n", g_creepHealth);
+      fprintf(stderr,"reward = %d\n", g_reward);
+      fprintf(stderr,"-----------------------------------------------\n");
+    }
+
+    /**
+     * @fn [maybe]
+     * ボードの初期化
+     * @param (board) 初期ボード
+     */
+    void initBoardData(const vector<string> &board){
+      fprintf(stderr,"initBoardData =>\n");
+      // ボードの縦幅を取得
+      g_boardHeight = board.size();
+
+      // ボードの横幅を取得
+      g_boardWidth  = board[0].size();
+
+      // セルの値を初期化
+      memset(g_cellType, UNDEFINED, sizeof(g_cellType));
+      memset(g_cellBasicDamage, 0, sizeof(g_cellBasicDamage));
+      memset(g_cellDamage, 0, sizeof(g_cellDamage));
+      memset(g_cellBasicValue, 0, sizeof(g_cellBasicValue));
+      memset(g_cellDefenseValue, 0, sizeof(g_cellDefenseValue));
+      memset(g_cellPathCount, 0, sizeof(g_cellPathCount));
+      memset(g_cellAroundPathCount, 0, sizeof(g_cellAroundPathCount));
+
+      // ボードの初期化
+      for(int y = 0; y < g_boardHeight; y++){
+        for(int x = 0; x < g_boardWidth; x++){
+          CELL cell = createCell(y, x);
+
+          // '#'は平地
+          if(board[y][x] == '#'){
+            g_cellType[y][x] = PLAIN;
+
+          // '.'は経路
+          }else if(board[y][x] == '.'){
+            g_cellType[y][x] = PATH;
+            // マップの端であればスポーン地点の追加を行う
+            if(isEdgeOfMap(y,x)){
+              int spawnId = g_spawnList.size();
+              assert(spawnId < MAX_S);
+              // cellのタイプをスポーン地点で上書き
+              g_cellType[y][x] = SPAWN_POINT;
+              cell.spawnId = spawnId;
+
+              // スポーン地点の追加
+              addSpawnPoint(spawnId, y, x);
+            }
+
+          // それ以外は基地
+          }else{
+            //! 基地のIDを取得
+            int baseId = char2int(board[y][x]);
+            g_cellType[y][x] = BASE_POINT;
+            cell.baseId = baseId;
+
+            // 基地を作成
+            BASE base = createBase(baseId, y, x);
+
+            // 基地の数を更新
+            g_baseCount += 1;
+
+            // 基地リストに入れる
+            g_baseList[baseId] = base;
+          }
+
+          // セルを代入
+          g_board[y][x] = cell;
+        }
+      }
+    }
+
+    /**
+     * @fn [complete]
+     * ロールアウト用のスレッドプールとスレッド毎の作業領域を用意
+     *
+     * @detail
+     * スレッドの数はコア数(最大MAX_THREAD)、1の場合は呼び出し元のスレッドだけで実行する
+     */
+    void initRolloutPool(){
+      int threadCount = min(MAX_THREAD, max(1, (int)thread::hardware_concurrency()));
+
+      g_rolloutPool.start(threadCount);
+      g_rolloutWorkers.resize(threadCount);
+      g_rolloutSerial = 0;
+    }
+
+    /**
+     * @fn [maybe]
+     * 攻撃範囲毎に、範囲に含まれる相対座標のリストを作成する
+     *
+     * @detail
+     * dy*dy + dx*dx <= range*range を満たす(dy, dx)を距離の近い順に並べておく。
+     * (同じ距離の場合はdy, dxの小さい順)
+     */
+    void initDiscKernel(){
+      for(int range = 0; range <= MAX_R; range++){
+        int size = 0;
+
+        for(int dy = -range; dy <= range; dy++){
+          for(int dx = -range; dx <= range; dx++){
+            int dist = dy*dy + dx*dx;
+
+            if(dist <= range * range){
+              g_discKernel[range][size++] = COORD(dy, dx, dist);
+            }
+          }
+        }
+
+        stable_sort(g_discKernel[range], g_discKernel[range] + size, [](const COORD &a, const COORD &b){
+          return a.dist < b.dist;
+        });
+
+        g_discKernelSize[range] = size;
+      }
+    }
+
+    /**
+     * @fn [maybe]
+     * タワー情報の初期化を行う
+     * @param (towerType) タワーの情報が格納されているリスト
+     *
+     * @detail
+     * コストパフォーマンスが最も良い1種類だけを残す
+     */
+    void initTowerData(const vector<int> &towerTypes){
+      // タワーの種類の数
+      g_towerCount = towerTypes.size() / 3;
+			g_realTowerCount = g_towerCount;
+
+      //fprintf(stderr,"towerCount = %d\n", g_towerCount);
+      priority_queue<TOWER, vector<TOWER>, greater<TOWER> > pque;
+
+      for(int towerType = 0; towerType < g_towerCount; towerType++){
+        int range  = towerTypes[towerType*3];
+        int damage = towerTypes[towerType*3+1];
+        int cost   = towerTypes[towerType*3+2];
+
+        // タワーの作成
+        TOWER tower = createTower(towerType, range, damage, cost);
+
+        // タワーの追加
+        g_towerList[towerType] = tower;
+
+        pque.push(tower);
+      }
+
+      g_towerCount = min(g_towerCount, 1);
+      g_towerMinCost = INT_MAX;
+      g_towerMaxRange = 0;
+
+      for(int id = 0; id < g_towerCount; id++){
+        TOWER tower = pque.top(); pque.pop();
+        showTowerData(tower.type);
+        tower.id = id;
+        g_towerList[id] = tower;
+        g_towerMinCost = min(g_towerMinCost, tower.cost);
+        g_towerMaxRange = max(g_towerMaxRange, tower.range);
+      }
+    }
+
+    /**
+     * @fn [complete]
+     * マップの端っこかどうかを調べる
+     * @param (y) Y座標
+     * @param (x) X座標
+     *
+     * @return マップの端かどうかの判定値
+     */
+    bool isEdgeOfMap(int y, int x){
+      return (y == 0 || x == 0 || y == g_boardHeight-1 || x == g_boardWidth-1);
+    }
+
+    /**
+     * @fn [complete]
+     * マップの端までの距離を計算
+     * @param (y) Y座標
+     * @param (x) X座標
+     *
+     * @return マップの端までの距離
+     */
+    int calcDistanceToEdge(int y, int x){
+      return min(min(y, g_boardHeight-y-1), min(x, g_boardWidth-1));
+    }
+
+    /**
+     * @fn [not yet]
+     * タワーを建設するべきかどうかを調べる
+     * 
+     * @return 建設するか否かの判定値
+     * @detail 
+     * なるべく後出しでタワーを建設したいのでギリギリまで建てないようにする
+     */
+    bool toBuildTower(){
+      return true;
+    }
+
+    /**
+     * @fn [maybe]
+     * どこにタワーを立てるのが良いかを調べてその座標を返す
+     *
+     * @return 建設する場所とタワーID
+     * @detail
+     * 評価値が変化した可能性のある場所だけ再計算して、セグメント木の根から最も良い場所を取り出す。
+     * 評価値が同じ場合は(y, x, タワーの種別)の小さいものを選ぶ
+     */
+    BUILD_INFO searchBestBuildPoint(){
+      PROFILE_SCOPE(PHASE_SEARCH_BEST_BUILD_POINT);
+
+      // キャッシュを最新の状態にする
+      refreshBuildValueCache();
+
+      int best = g_buildValueTree[1];
+
+      // 評価値が正の場所が無い場合は建設しない
+      if(g_buildBestValue[best] <= 0){
+        return BUILD_INFO();
+      }
+
+      return BUILD_INFO(g_buildBestType[best], best / MAX_N, best % MAX_N);
+    }
+
+    /**
+     * @fn [maybe]
+     * 建設評価値のキャッシュを初期化する
+     *
+     * @detail
+     * 被覆行列を作り、全ての平地に対して評価値を計算してセグメント木を作る
+     */
+    void initBuildValueCache(){
+      assert(MAX_N * MAX_N <= BUILD_TREE_SIZE);
+
+      memset(g_dirtyCellFlag, false, sizeof(g_dirtyCellFlag));
+      g_dirtyCellCount = 0;
+
+      initCoverMatrix();
+
+      for(int pathCellId = 0; pathCellId < g_pathCellCount; pathCellId++){
+        COORD coord = g_pathCellList[pathCellId];
+        updateCoverWeight(coord.y, coord.x);
+      }
+
+      for(int z = 0; z < BUILD_TREE_SIZE; z++){
+        g_buildBestValue[z] = INT_MIN;
+        g_buildBestType[z] = UNDEFINED;
+        g_buildValueTree[BUILD_TREE_SIZE + z] = z;
+      }
+
+      // セル毎に独立しているので、行毎にスレッドで分担する
+      g_rolloutPool.run(g_boardHeight, [&](int /*threadId*/, int y){
+        for(int x = 0; x < g_boardWidth; x++){
+          updateBuildValue(y, x);
+        }
+      });
+
+      for(int node = BUILD_TREE_SIZE-1; node >= 1; node--){
+        g_buildValueTree[node] = selectBetterBuildPoint(g_buildValueTree[2*node], g_buildValueTree[2*node+1]);
+      }
+    }
+
+    /**
+     * @fn [maybe]
+     * 被覆行列を作る
+     *
+     * @detail
+     * 平地のセル毎に、最大の攻撃範囲に入る経路のセルを距離の近い順に並べ、攻撃範囲毎の終了位置を記録する。
+     * 経路以外のセルとマップの外に接する辺は評価値に攻撃力や定数を掛けて効くだけなので、攻撃範囲毎の数だけ持つ。
+     * 平地がタワーになっても評価値への効き方は同じなので、ゲーム中に作り直す必要は無い
+     */
+    void initCoverMatrix(){
+      memset(g_pathCellIndex, UNDEFINED, sizeof(g_pathCellIndex));
+      g_pathCellCount = 0;
+
+      for(int y = 0; y < g_boardHeight; y++){
+        for(int x = 0; x < g_boardWidth; x++){
+          if(isPathType(g_cellType[y][x])){
+            g_pathCellIndex[y][x] = g_pathCellCount;
+            g_pathCellList[g_pathCellCount++] = COORD(y, x);
+          }
+        }
+      }
+
+      // 各行の長さを数えてから開始位置を決め、行毎の中身はスレッドで分担して埋める
+      g_rolloutPool.run(g_boardHeight, [&](int /*threadId*/, int y){
+        for(int x = 0; x < g_boardWidth; x++){
+          g_coverRowStart[y * MAX_N + x] = countCoverRow(y, x);
+        }
+      });
+
+      int coverCount = 0;
+
+      for(int y = 0; y < g_boardHeight; y++){
+        for(int x = 0; x < g_boardWidth; x++){
+          int z = y * MAX_N + x;
+          int length = g_coverRowStart[z];
+
+          g_coverRowStart[z] = coverCount;
+          coverCount += length;
+        }
+      }
+      assert(coverCount <= MAX_COVER);
+
+      g_rolloutPool.run(g_boardHeight, [&](int /*threadId*/, int y){
+        for(int x = 0; x < g_boardWidth; x++){
+          fillCoverRow(y, x);
+        }
+      });
+    }
+
+    /**
+     * @fn [maybe]
+     * 被覆行列の行の長さ(最大の攻撃範囲に入る経路のセルの数)を数える
+     * @param (y) Y座標
+     * @param (x) X座標
+     *
+     * @return 行の長さ(平地以外は0)
+     */
+    int countCoverRow(int y, int x){
+      if(getCell(y, x)->isNotPlain()) return 0;
+
+      const COORD *kernel = g_discKernel[MAX_R];
+      int size = g_discKernelSize[MAX_R];
+      int length = 0;
+
+      for(int i = 0; i < size; i++){
+        int ny = y + kernel[i].y;
+        int nx = x + kernel[i].x;
+
+        if(isInsideMap(ny, nx) && isPathType(g_cellType[ny][nx])){
+          length++;
+        }
+      }
+
+      return length;
+    }
+
+    /**
+     * @fn [maybe]
+     * 被覆行列の行を埋める
+     * @param (y) Y座標
+     * @param (x) X座標
+     *
+     * @detail
+     * g_coverRowStartの位置から書き込む。行毎に書き込む場所が分かれているので、別の行と同時に呼んでも良い
+     */
+    void fillCoverRow(int y, int x){
+      const COORD *kernel = g_discKernel[MAX_R];
+      int size = g_discKernelSize[MAX_R];
+      int z = y * MAX_N + x;
+      int coverCount = g_coverRowStart[z];
+      int blockCount = 0;
+      int edgeCount = 0;
+      int range = 0;
+
+      // 平地以外は空の行にする
+      for(int i = 0; i < size && getCell(y, x)->isPlain(); i++){
+        int ny = y + kernel[i].y;
+        int nx = x + kernel[i].x;
+
+        // 距離が攻撃範囲を超えたら、そこまでを攻撃範囲の行にする
+        while(range * range < kernel[i].dist){
+          g_coverRowEnd[z][range] = coverCount;
+          g_coverBlockCount[z][range] = blockCount;
+          g_coverEdgeCount[z][range] = edgeCount;
+          range++;
+        }
+
+        if(isOutsideMap(ny, nx)) continue;
+
+        int type = g_cellType[ny][nx];
+
+        if(isPathType(type)){
+          g_coverColumn[coverCount] = g_pathCellIndex[ny][nx];
+          coverCount++;
+        }else if(type == BASE_POINT || type == PLAIN || type == TOWER_POINT){
+          blockCount += 1;
+        }
+
+        for(int direct = 0; direct < 4; direct++){
+          if(isOutsideMap(ny + DY[direct], nx + DX[direct])){
+            edgeCount += 1;
+          }
+        }
+      }
+
+      for(; range <= MAX_R; range++){
+        g_coverRowEnd[z][range] = coverCount;
+        g_coverBlockCount[z][range] = blockCount;
+        g_coverEdgeCount[z][range] = edgeCount;
+      }
+    }
+
+    /**
+     * @fn [maybe]
+     * 経路のセルの評価値の重みを更新する
+     * @param (y) Y座標
+     * @param (x) X座標
+     *
+     * @detail
+     * 評価値 = 重み(定数) + 攻撃力 × 重み(攻撃力) になるように分ける。経路以外のセルは何もしない
+     */
+    void updateCoverWeight(int y, int x){
+      int pathCellId = g_pathCellIndex[y][x];
+      if(pathCellId == UNDEFINED) return;
+
+      int basicDamage = g_cellBasicDamage[y][x];
+      int pathCount = g_cellPathCount[y][x];
+      int weightConst = g_cellBasicValue[y][x] + g_cellDefenseValue[y][x];
+      int weightDamage;
+
+      if(basicDamage == 0){
+        weightConst += 2 * pathCount;
+        weightDamage = 4;
+      }else{
+        weightConst -= min(basicDamage, g_creepHealth * 8);
+        weightDamage = pathCount;
+      }
+
+      if(g_cellAroundPathCount[y][x] > 2){
+        weightDamage += g_cellAroundPathCount[y][x] - 1;
+      }
+
+      g_coverWeightConst[pathCellId] = weightConst;
+      g_coverWeightDamage[pathCellId] = weightDamage;
+    }
+
+    /**
+     * @fn [maybe]
+     * 建設評価値に関わる値が変化したセルを登録する
+     * @param (y) Y座標
+     * @param (x) X座標
+     *
+     * @detail
+     * セルの種別や経路の攻撃力、基礎点、防御価値を変更した場合は必ず呼ぶこと
+     */
+    void markBuildValueDirty(int y, int x){
+      if(g_dirtyCellFlag[y][x]) return;
+
+      g_dirtyCellFlag[y][x] = true;
+      g_dirtyCellList[g_dirtyCellCount++] = COORD(y, x);
+    }
+
+    /**
+     * @fn [maybe]
+     * 値が変化したセルを攻撃範囲に含む場所の評価値を再計算する
+     */
+    void refreshBuildValueCache(){
+      static bool candidateFlag[MAX_N][MAX_N];
+      static COORD candidateList[MAX_N*MAX_N];
+      int candidateCount = 0;
+
+      // 変化したセルを攻撃範囲に含む可能性のある場所を列挙する
+      for(int i = 0; i < g_dirtyCellCount; i++){
+        COORD coord = g_dirtyCellList[i];
+        g_dirtyCellFlag[coord.y][coord.x] = false;
+        updateCoverWeight(coord.y, coord.x);
+
+        forEachCellInRange(coord.y, coord.x, g_towerMaxRange, [&](int y, int x, int /*dist*/){
+          if(candidateFlag[y][x]) return;
+
+          candidateFlag[y][x] = true;
+          candidateList[candidateCount++] = COORD(y, x);
+        });
+      }
+      g_dirtyCellCount = 0;
+
+      for(int i = 0; i < candidateCount; i++){
+        COORD coord = candidateList[i];
+        candidateFlag[coord.y][coord.x] = false;
+
+        updateBuildValue(coord.y, coord.x);
+        updateBuildValueTree(coord.y * MAX_N + coord.x);
+      }
+    }
+
+    /**
+     * @fn [maybe]
+     * 指定した場所の建設評価値を再計算して、そのセルの最も良い評価値とタワーの種別を更新する
+     * @param (y) Y座標
+     * @param (x) X座標
      */
-    int init(vector<string> board, int money, int creepHealth, int creepMoney, vector<int> towerTypes){
-      fprintf(stderr,"init =>\n");
+    void updateBuildValue(int y, int x){
+      CELL *cell = getCell(y, x);
+      int z = y * MAX_N + x;
 
-      // ターンを初期化を行う
-      g_currentTurn = 0;
+      g_buildBestValue[z] = INT_MIN;
+      g_buildBestType[z] = UNDEFINED;
 
-			// このゲームを諦める
-			g_giveup = true;
+      // 平地以外は候補にしない
+      if(cell->isNotPlain()) return;
 
-      // 出現した敵の総数を初期化
-      g_totalCreepCount = 0;
+      // 攻撃範囲毎の重みの合計(被覆行列の行と重みの積)
+      int weightConst[MAX_R+1];
+      int weightDamage[MAX_R+1];
+      sumCoverWeight(z, weightConst, weightDamage);
 
-      // 基地の数を初期化
-      g_baseCount = 0;
+      // 全てのタワーで処理を行う
+      for(int towerType = 0; towerType < g_towerCount; towerType++){
+        TOWER *tower = referTower(towerType);
+        int value = calcBuildValue(y, x, tower->range, tower->damage, weightConst[tower->range], weightDamage[tower->range]);
 
-      // 最短路マップの初期化
-      memset(g_shortestPathMap, UNDEFINED, sizeof(g_shortestPathMap));
+        if(g_buildBestValue[z] < value){
+          g_buildBestValue[z] = value;
+          g_buildBestType[z] = towerType;
+        }
+      }
+    }
 
-			// 狙われ安さの初期化
-			memset(g_targetedBasePoint, 0, sizeof(g_targetedBasePoint));
+    /**
+     * @fn [maybe]
+     * セグメント木の葉から根までを更新する
+     * @param (z) 更新したセルの番号(y*MAX_N+x)
+     */
+    void updateBuildValueTree(int z){
+      int node = (BUILD_TREE_SIZE + z) / 2;
 
-      // 敵の初期体力の初期化
-      g_creepHealth = creepHealth;
+      while(node >= 1){
+        g_buildValueTree[node] = selectBetterBuildPoint(g_buildValueTree[2*node], g_buildValueTree[2*node+1]);
+        node /= 2;
+      }
+    }
 
-      // ボードの初期化を行う
-      initBoardData(board);
+    /**
+     * @fn [complete]
+     * 2つのセルのうち建設評価値の良い方を返す
+     * @param (left)  番号の小さいセル
+     * @param (right) 番号の大きいセル
+     *
+     * @return 評価値の良いセルの番号(同じ場合はleft)
+     */
+    inline int selectBetterBuildPoint(int left, int right){
+      return (g_buildBestValue[left] < g_buildBestValue[right])? right : left;
+    }
 
-      // カバーできる経路の数を計算
-      initCoverCellCount();
+    /**
+     * @fn [maybe]
+     * ターンの持ち時間の中で、先読みのターン数とロールアウトの数を段階的に増やしながら危険度を調べる
+     * @param (threat) 結果の書き込み先
+     *
+     * @return 一番危ない基地のID(基地に到達されなかった場合はNOT_REACH)
+     * @detail
+     * 最初の段階は必ず行い、次の段階は直前の段階にかかった時間から見積もって持ち時間に収まる場合だけ行う。
+     * 始めた段階は最後まで行うので、常に最後に終わった段階の結果を使える
+     */
+    int searchThreat(THREAT_INFO *threat){
+      int baseHorizon = calcBaseHorizon();
+      int horizon = baseHorizon;
+      int rolloutCount = ROLLOUT_COUNT;
+      int baseId;
+      double cost;
+
+      // ターンの合間に同じ評価を済ませていればそれを使う
+      if(!takeSpeculation(threat, rolloutCount, horizon, &baseId, &cost)){
+        double startTime = g_searchBudget.elapsed();
+        baseId = evaluateThreat(threat, rolloutCount, horizon);
+        cost = g_searchBudget.elapsed() - startTime;
+      }
 
-      // タワーの初期化を行う
-      initTowerData(towerTypes);
+      for(int depth = 1; depth < MAX_SEARCH_DEPTH; depth++){
+        int nextRolloutCount = min(MAX_ROLLOUT_COUNT, 2 * rolloutCount);
+        int nextHorizon = horizon + baseHorizon / 2;
+        double nextCost = cost * nextRolloutCount / rolloutCount * nextHorizon / max(1, horizon);
 
-      // スポーン地点から基地までの最短路を計算
-      initCellToBaseShortestPath();
+        if(!g_searchBudget.canAfford(nextCost)) break;
 
-      // 初期の所持金
-      g_currentAmountMoney = money;
+        rolloutCount = nextRolloutCount;
+        horizon = nextHorizon;
 
-      // 建設したタワーの数を初期化
-      g_buildedTowerCount = 0;
+        double startTime = g_searchBudget.elapsed();
+        baseId = evaluateThreat(threat, rolloutCount, horizon);
+        cost = g_searchBudget.elapsed() - startTime;
+      }
 
-      // 報酬の初期化
-      g_reward = creepMoney;
+      return baseId;
+    }
 
-      // セルの防御価値を初期化
-      initCellBasicValue();
+    /**
+     * @fn [maybe]
+     * 危険度の評価の最初の段階で先読みするターン数を返す
+     *
+     * @detail
+     * 敵が多い時は盤面の幅の1/2、少ない時は1/4
+     */
+    int calcBaseHorizon(){
+      int rate = (g_simState.alive.size() >= 10)? 2 : 4;
+      return g_boardWidth / rate;
+    }
 
-      // ゲーム情報の表示
-      showGameData();
-      
-      return 0;
+    /**
+     * @fn [maybe]
+     * ターンの合間の先読みを行うようにする
+     */
+    void enableSpeculation(){
+      g_speculation.enabled = true;
     }
 
     /**
      * @fn [maybe]
-     * ゲームの基礎情報を表示
-     *   - 敵の基礎体力
-     *   - 敵を倒した時の報酬
+     * 入力を待つ間に、次のターンの危険度の評価を別スレッドで始める
+     *
+     * @detail
+     * 先読みのスレッドが動いている間は、呼び出し元はfinishSpeculationを呼ぶまで盤面の情報に触れないこと
      */
-    void showGameData(){
-      fprintf(stderr,"-----------------------------------------------\n");
-			fprintf(stderr,"Tower count = %d\n", g_realTowerCount);
-			fprintf(stderr,"Base count = %d\n", g_baseCount);
-      fprintf(stderr,"BoardSize = Y: %d, X: %d\n", g_boardHeight, g_boardWidth);
-      fprintf(stderr,"creepHealth = %d\n", g_creepHealth);
-      fprintf(stderr,"reward = %d\n", g_reward);
-      fprintf(stderr,"-----------------------------------------------\n");
+    void startSpeculation(){
+      if(!g_speculation.enabled || g_currentTurn >= LIMIT_TURN) return;
+
+      g_speculation.ready = false;
+      g_cancelRollouts = false;
+      g_speculation.worker = thread([this](){ speculate(); });
     }
 
     /**
      * @fn [maybe]
-     * ボードの初期化
-     * @param (board) 初期ボード
+     * 次のターンの入力が届いたので先読みを止めて、スレッドの終了を待つ
+     *
+     * @detail
+     * 実行中のロールアウトは最後まで行い、残りは打ち切る(打ち切った評価の結果は使わない)
      */
-    void initBoardData(vector<string> &board){
-      fprintf(stderr,"initBoardData =>\n");
-      // ボードの縦幅を取得
-      g_boardHeight = board.size();
+    void finishSpeculation(){
+      if(!g_speculation.worker.joinable()) return;
 
-      // ボードの横幅を取得
-      g_boardWidth  = board[0].size();
+      g_cancelRollouts = true;
+      g_speculation.worker.join();
+      g_cancelRollouts = false;
+    }
 
-      // ボードの初期化
-      for(int y = 0; y < g_boardHeight; y++){
-        for(int x = 0; x < g_boardWidth; x++){
-          CELL cell = createCell(y, x);
+    /**
+     * @fn [maybe]
+     * 予想した次のターンの盤面で、最初の段階の危険度の評価を行う(先読みのスレッドで実行する)
+     *
+     * @detail
+     * 評価は観測した盤面(g_simState)に対して行うので、予想した盤面と入れ替えて評価した後に元に戻す。
+     * ロールアウトの通し番号も、次のターンに同じ番号で評価出来るように元に戻す
+     */
+    void speculate(){
+      if(!predictNextState(&g_speculation.state)) return;
 
-          // '#'は平地
-          if(board[y][x] == '#'){
-            cell.type = PLAIN;
+      swap(g_simState, g_speculation.state);
 
-          // '.'は経路
-          }else if(board[y][x] == '.'){
-            cell.type = PATH;
-            // マップの端であればスポーン地点の追加を行う
-            if(isEdgeOfMap(y,x)){
-              int spawnId = g_spawnList.size();
-              // cellのタイプをスポーン地点で上書き
-              cell.type = SPAWN_POINT;
-              cell.spawnId = spawnId;
+      int rolloutSerial = g_rolloutSerial;
+      int rolloutCount = ROLLOUT_COUNT;
+      int horizon = calcBaseHorizon();
+      chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
 
-              // スポーン地点の追加
-              addSpawnPoint(spawnId, y, x);
-            }
+      int baseId = evaluateThreat(&g_speculation.threat, rolloutCount, horizon);
 
-          // それ以外は基地
-          }else{
-            //! 基地のIDを取得
-            int baseId = char2int(board[y][x]);
-            cell.type = BASE_POINT;
-            cell.baseId = baseId;
+      if(!g_cancelRollouts){
+        int workerCount = g_rolloutPool.size();
 
-            // 基地を作成
-            BASE base = createBase(baseId, y, x);
+        g_speculation.ready         = true;
+        g_speculation.turn          = g_currentTurn;
+        g_speculation.rolloutSerial = g_rolloutSerial;
+        g_speculation.rolloutCount  = rolloutCount;
+        g_speculation.horizon       = horizon;
+        g_speculation.baseId        = baseId;
+        g_speculation.cost          = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
 
-            // 基地の数を更新
-            g_baseCount += 1;
+        for(int y = 0; y < g_boardHeight; y++){
+          for(int x = 0; x < g_boardWidth; x++){
+            ll sum = 0;
 
-            // 基地リストに入れる
-            g_baseList[baseId] = base;
-          }
+            for(int threadId = 0; threadId < workerCount; threadId++){
+              sum += g_rolloutWorkers[threadId].defenseValue[y][x];
+            }
 
-          assert(cell.damage == 0);
-          // セルを代入
-          g_board[y][x] = cell;
+            g_speculation.defenseValue[y][x] = sum;
+          }
         }
       }
+
+      g_rolloutSerial = rolloutSerial;
+      swap(g_simState, g_speculation.state);
     }
 
     /**
      * @fn [maybe]
-     * カバー出来る経路の数を初期化
+     * 観測した盤面から、次のターンの盤面を予想する
+     * @param (next) 予想した盤面の書き込み先
+     *
+     * @return 予想出来たかどうか(最短路の無いセルに敵がいる場合は予想しない)
+     * @detail
+     * 敵は今いるセルから向かえる基地のうちIDの一番小さい基地への最短路を1歩進むものとして、
+     * 移動・基地への到達・タワーの攻撃を1ステップ進める。新しく出現する敵は分からないので含めない。
+     * 生き残った敵は入力と同じ並び(観測した盤面の並び)に並べ直す
      */
-    void initCoverCellCount(){
-      // マップ全体を更新
-      for(int y = 0; y < g_boardHeight; y++){
-        for(int x = 0; x < g_boardWidth; x++){
-          CELL *cell = getCell(y,x);
+    bool predictNextState(SIM_STATE *next){
+      g_simState.fork(next);
 
-          // 基地が建設出来ない場所は飛ばす
-          if(cell->isNotPlain()) continue;
+      int aliveCount = g_simState.alive.count;
 
-          // 攻撃範囲1-5までを処理
-          for(int range = 1; range <= MAX_R; range++){
-            int pathCount = calcCoverPathCount(y, x, range);
-            coverPathCount[y][x][range] = pathCount;
-          }
+      for(int i = 0; i < aliveCount; i++){
+        int creepId = g_simState.alive.ids[i];
+        unsigned int mask = g_board[g_simState.creepY[creepId]][g_simState.creepX[creepId]].basePaths;
+
+        if(mask == 0) return false;
+        next->creepTargetBase[creepId] = __builtin_ctz(mask);
+      }
+
+      next->step([](int, int, int){}, [](int, int, int, int){});
+
+      // 生き残った敵を観測した順に並べ直す
+      vector<int> survivors;
+      for(int i = 0; i < aliveCount; i++){
+        int creepId = g_simState.alive.ids[i];
+        int index = next->alive.index[creepId];
+
+        if(index < next->alive.count && next->alive.ids[index] == creepId){
+          survivors.push_back(creepId);
         }
       }
+
+      next->alive.clear();
+      for(int i = 0; i < survivors.size(); i++){
+        int creepId = survivors[i];
+        next->addCreep(creepId, next->creepHp[creepId], next->creepY[creepId], next->creepX[creepId]);
+      }
+      next->rebuildCellCreepList();
+      next->stepCount = 0;
+
+      return true;
     }
 
     /**
      * @fn [maybe]
-     * タワー情報の初期化を行う
-     * @param (towerType) タワーの情報が格納されているリスト
+     * ターンの合間に済ませた評価が使えれば、その結果を取り出す
+     * @param (threat)        結果の書き込み先
+     * @param (rolloutCount)  ロールアウトの数
+     * @param (horizon)       先読みするターン数
+     * @param (baseId)        一番危ない基地のIDの書き込み先
+     * @param (cost)          評価にかかった時間(ms)の書き込み先
      *
+     * @return 使えたかどうか
      * @detail
-     * コストパフォーマンスの良いタワー上位5つを残す
+     * 敵(並び・体力・座標)・基地の体力・タワーの数が全て予想と一致する場合だけ使う。
+     * 防御価値は0番目のスレッドの作業領域に入れておく(applyThreatは全てのスレッドの合計を使う)
      */
-    void initTowerData(vector<int> &towerTypes){
-      // タワーの種類の数
-      g_towerCount = towerTypes.size() / 3;
-			g_realTowerCount = g_towerCount;
-
-      //fprintf(stderr,"towerCount = %d\n", g_towerCount);
-      priority_queue<TOWER, vector<TOWER>, greater<TOWER> > pque;
-
-      for(int towerType = 0; towerType < g_towerCount; towerType++){
-        int range  = towerTypes[towerType*3];
-        int damage = towerTypes[towerType*3+1];
-        int cost   = towerTypes[towerType*3+2];
+    bool takeSpeculation(THREAT_INFO *threat, int rolloutCount, int horizon, int *baseId, double *cost){
+      if(!g_speculation.ready) return false;
+      g_speculation.ready = false;
+
+      if(g_speculation.turn != g_currentTurn || g_speculation.rolloutSerial != g_rolloutSerial + 1 ||
+          g_speculation.rolloutCount != rolloutCount || g_speculation.horizon != horizon ||
+          !isSameObservedState(g_speculation.state, g_simState)){
+        g_speculation.missCount += 1;
+        return false;
+      }
 
-        // タワーの作成
-        TOWER tower = createTower(towerType, range, damage, cost);
+      g_speculation.hitCount += 1;
+      g_rolloutSerial += 1;
 
-        // タワーの追加
-        g_towerList[towerType] = tower;
+      *threat = g_speculation.threat;
+      *baseId = g_speculation.baseId;
+      *cost   = g_speculation.cost;
 
-        pque.push(tower);
+      int workerCount = g_rolloutPool.size();
+      memcpy(g_rolloutWorkers[0].defenseValue, g_speculation.defenseValue, sizeof(g_speculation.defenseValue));
+      for(int threadId = 1; threadId < workerCount; threadId++){
+        memset(g_rolloutWorkers[threadId].defenseValue, 0, sizeof(g_rolloutWorkers[threadId].defenseValue));
       }
 
-      g_towerCount = min(g_towerCount, 1);
-      g_towerMinCost = INT_MAX;
-
-      for(int id = 0; id < g_towerCount; id++){
-        TOWER tower = pque.top(); pque.pop();
-        showTowerData(tower.type);
-        tower.id = id;
-        g_towerList[id] = tower;
-        g_towerMinCost = min(g_towerMinCost, tower.cost);
-      }
+      return true;
     }
 
     /**
-     * @fn [complete]
-     * マップの端っこかどうかを調べる
-     * @param (y) Y座標
-     * @param (x) X座標
+     * @fn [maybe]
+     * 2つの盤面が、入力から作られる部分で一致するかどうかを調べる
+     * @param (a) 盤面
+     * @param (b) 盤面
      *
-     * @return マップの端かどうかの判定値
+     * @return 一致するかどうか
      */
-    bool isEdgeOfMap(int y, int x){
-      return (y == 0 || x == 0 || y == g_boardHeight-1 || x == g_boardWidth-1);
+    bool isSameObservedState(const SIM_STATE &a, const SIM_STATE &b){
+      if(a.alive.count != b.alive.count || a.towerCount != b.towerCount) return false;
+
+      for(int i = 0; i < a.alive.count; i++){
+        int creepId = a.alive.ids[i];
+
+        if(b.alive.ids[i] != creepId) return false;
+        if(a.creepHp[creepId] != b.creepHp[creepId]) return false;
+        if(a.creepY[creepId] != b.creepY[creepId] || a.creepX[creepId] != b.creepX[creepId]) return false;
+      }
+
+      for(int baseId = 0; baseId < g_baseCount; baseId++){
+        if(a.baseHealth[baseId] != b.baseHealth[baseId]) return false;
+      }
+
+      return true;
     }
 
     /**
-     * @fn [complete]
-     * マップの端までの距離を計算
-     * @param (y) Y座標
-     * @param (x) X座標
+     * @fn [maybe]
+     * 敵の狙う基地をランダムに決めた先読みを何回も行い、基地毎の危険度をまとめる
+     * @param (threat)        結果の書き込み先
+     * @param (rolloutCount)  ロールアウトの数
+     * @param (horizon)       先読みするターン数
      *
-     * @return マップの端までの距離
+     * @return 一番危ない基地のID(どのロールアウトでも基地に到達されなかった場合はNOT_REACH)
+     * @detail
+     * ロールアウトはスレッドプールで並列に行う。乱数の種は呼び出し回数とロールアウトの番号から作るので、
+     * スレッドの数によらず結果は同じになる
      */
-    int calcDistanceToEdge(int y, int x){
-      return min(min(y, g_boardHeight-y-1), min(x, g_boardWidth-1));
-    }
+    int evaluateThreat(THREAT_INFO *threat, int rolloutCount, int horizon){
+      PROFILE_SCOPE(PHASE_EVALUATE_THREAT);
+      assert(rolloutCount <= MAX_ROLLOUT_COUNT);
 
-    /**
-     * @fn [not yet]
-     * タワーを建設するべきかどうかを調べる
-     * 
-     * @return 建設するか否かの判定値
-     * @detail 
-     * なるべく後出しでタワーを建設したいのでギリギリまで建てないようにする
-     */
-    bool toBuildTower(){
-      return true;
+      ROLLOUT_RESULT results[MAX_ROLLOUT_COUNT];
+      int workerCount = g_rolloutPool.size();
+
+      g_rolloutSerial += 1;
+
+      memset(threat, 0, sizeof(THREAT_INFO));
+      threat->rolloutCount = rolloutCount;
+
+      // 基地に着く可能性のある敵が居なければ、どのロールアウトも到達されないので省略する
+      countNearCreeps(horizon, threat);
+      if(threat->nearCreepCount == 0){
+        PROFILE_COUNT(COUNTER_SKIPPED_THREATS, 1);
+        return NOT_REACH;
+      }
+
+      for(int threadId = 0; threadId < workerCount; threadId++){
+        memset(g_rolloutWorkers[threadId].defenseValue, 0, sizeof(g_rolloutWorkers[threadId].defenseValue));
+      }
+
+      g_rolloutPool.run(rolloutCount, [&](int threadId, int rolloutId){
+        if(g_cancelRollouts) return;
+        runRollout(&g_rolloutWorkers[threadId], rolloutId, horizon, &results[rolloutId]);
+      });
+
+      // 打ち切った場合は結果を使わない
+      if(g_cancelRollouts) return NOT_REACH;
+
+      // 結果を基地毎にまとめる
+      for(int rolloutId = 0; rolloutId < rolloutCount; rolloutId++){
+        ROLLOUT_RESULT *result = &results[rolloutId];
+
+        if(result->reachBaseId != NOT_REACH){
+          threat->reachCount += 1;
+          threat->breachProbability[result->reachBaseId] += 1.0 / rolloutCount;
+        }
+        for(int baseId = 0; baseId < g_baseCount; baseId++){
+          threat->expectedDamage[baseId] += (double)result->damage[baseId] / rolloutCount;
+        }
+      }
+
+      if(threat->reachCount == 0) return NOT_REACH;
+
+      // 到達される確率が一番高い基地(同じ場合はダメージの期待値が大きい方)
+      int mostThreatenedBaseId = 0;
+      for(int baseId = 1; baseId < g_baseCount; baseId++){
+        double prob = threat->breachProbability[baseId];
+        double bestProb = threat->breachProbability[mostThreatenedBaseId];
+
+        if(prob > bestProb || (prob == bestProb && threat->expectedDamage[baseId] > threat->expectedDamage[mostThreatenedBaseId])){
+          mostThreatenedBaseId = baseId;
+        }
+      }
+
+      return mostThreatenedBaseId;
     }
 
     /**
      * @fn [maybe]
-     * どこにタワーを立てるのが良いかを調べてその座標を返す
+     * ロールアウトを1回行う
+     * @param (worker)    作業領域
+     * @param (rolloutId) ロールアウトの番号
+     * @param (horizon)   先読みするターン数
+     * @param (result)    結果の書き込み先
      *
-     * @return 建設する場所とタワーID
+     * @detail
+     * 観測した状態を複製して進めるので、観測した状態は書き換えない(別スレッドから呼んで良い)。
+     * 最初に基地に到達されるまでに敵が通ったセルの防御価値は、基地に到達された場合だけ作業領域に足し込む
      */
-    BUILD_INFO searchBestBuildPoint(){
-      int bestValue = 0;
-      int bestY = UNDEFINED;
-      int bestX = UNDEFINED;
-      int bestType = UNDEFINED;
+    void runRollout(ROLLOUT_WORKER *worker, int rolloutId, int horizon, ROLLOUT_RESULT *result){
+      PROFILE_COUNT(COUNTER_ROLLOUTS, 1);
 
-      // マップ全体に対して処理を行う
-      for(int y = 0; y < g_boardHeight; y++){
-        for(int x = 0; x < g_boardWidth; x++){
-          // セル情報を取得
-          CELL *cell = getCell(y,x);
+      SIM_STATE *sim = &worker->state;
+      g_simState.fork(sim);
 
-          // 平地以外は処理を飛ばす
-          if(cell->isNotPlain()) continue;
+      // 敵の狙う基地をロールアウト毎の乱数で決める
+      XOR_SHIFT rng;
+      rng.setSeed((unsigned long long)g_rolloutSerial * MAX_ROLLOUT_COUNT + rolloutId);
+      sim->sampleTargetBases(&rng);
 
-          // 全てのタワーで処理を行う
-          for(int towerType = 0; towerType < g_towerCount; towerType++){
-            TOWER *tower = referTower(towerType);
-            int value = calcBuildValue(y, x, tower->range, tower->damage);
+      memset(worker->rolloutDefenseValue, 0, sizeof(worker->rolloutDefenseValue));
+      result->reachBaseId = NOT_REACH;
 
-            // 評価値が更新されたら建設情報を更新
-            if(bestValue < value){
-              bestValue = value;
-              bestType = towerType;
-              bestY = y;
-              bestX = x;
-            }
+      auto addRouteValue = [&](int creepId, int y, int x){
+        if(result->reachBaseId == NOT_REACH && g_cellPathCount[y][x] > 0){
+          worker->rolloutDefenseValue[y][x] += g_cellPathCount[y][x] * sim->creepHp[creepId];
+        }
+      };
+
+      // 攻撃の届かない区間は体力が変わらないので、区間のセルを辿って同じように加える
+      auto addCorridorValue = [&](int creepId, int y, int x, int length){
+        if(result->reachBaseId != NOT_REACH) return;
+
+        int baseId = sim->creepTargetBase[creepId];
+
+        for(int i = 0; i < length; i++){
+          int direct = g_shortestPathMap[y][x][baseId];
+          y += DY[direct];
+          x += DX[direct];
+          addRouteValue(creepId, y, x);
+        }
+      };
+
+			int turn = 0;
+      // 全ての敵に対して処理する
+      while(!sim->alive.empty()){
+				if(g_currentTurn + turn >= 2000) break;
+				if(turn >= horizon) break;
+
+        // 全ての敵が攻撃の届かない区間の途中なら、誰かが区間を抜けるまで飛ばす
+        int idleStep = min(sim->idleStepCount(), min(horizon, LIMIT_TURN - g_currentTurn) - turn);
+        if(idleStep > 0){
+          sim->skipIdleSteps(idleStep);
+          turn += idleStep;
+          continue;
+        }
+
+        // 敵の移動とタワーの攻撃、基地に到達されるまでは通った経路に防御価値を加える
+        int baseId = sim->step(addRouteValue, addCorridorValue);
+
+        if(result->reachBaseId == NOT_REACH){
+          // 攻撃の届かない区間の途中にいる敵も、ここまで通った経路に防御価値を加える
+          if(baseId != NOT_REACH){
+            sim->visitSleepingCreeps(addCorridorValue);
+          }
+          result->reachBaseId = baseId;
+        }
+
+        turn += 1;
+      }
+
+      for(int baseId = 0; baseId < g_baseCount; baseId++){
+        result->damage[baseId] = g_simState.baseHealth[baseId] - sim->baseHealth[baseId];
+      }
+
+      if(result->reachBaseId != NOT_REACH){
+        for(int y = 0; y < g_boardHeight; y++){
+          for(int x = 0; x < g_boardWidth; x++){
+            worker->defenseValue[y][x] += worker->rolloutDefenseValue[y][x];
           }
         }
       }
-
-			//assert(bestType != UNDEFINED);
-      return BUILD_INFO(bestType, bestY, bestX);
     }
 
     /**
-     * @fn [not yet]
-     * いずれかの敵が基地に到達出来るかどうかを確認
+     * @fn [maybe]
+     * ロールアウトの結果をセルの防御価値に反映する
+     * @param (threat) ロールアウトの結果
      *
-     * @return どこかの基地に到達できるかどうかの判定値
      * @detail
-     * 現在のタワーの建設状態から何もしなくても敵を倒せるのかどうかを調べる
+     *   - 敵が通ったセルには、基地に到達されたロールアウトでの防御価値の平均を加える
+     *   - 基地の周りのセルには、到達される確率が一番高い基地を基準にして確率に比例した防御価値を加える
      */
-    int isAnyCreepReachableBase(){
-			int turn = 0;
-      int rate = (g_aliveCreepsIdList.size() >= 10)? 2 : 4;
-      // 全ての敵に対して処理する
-      while(!g_aliveCreepsIdList.empty()){
-				if(g_currentTurn + turn >= 2000) break;
-				if(turn >= g_boardWidth/rate) break;
-        // 敵の移動
-        moveCreeps();
+    void applyThreat(THREAT_INFO *threat){
+      PROFILE_SCOPE(PHASE_APPLY_THREAT);
 
-        // いずれかの敵が基地に到着していたらtrueを返す
-        int baseId = isAnyCreepReachBase();
-        if(baseId != NOT_REACH) return baseId;
+      int workerCount = g_rolloutPool.size();
+
+      for(int y = 0; y < g_boardHeight; y++){
+        for(int x = 0; x < g_boardWidth; x++){
+          ll sum = 0;
 
-        // 敵のロック
-        updateTowerData();
+          for(int threadId = 0; threadId < workerCount; threadId++){
+            sum += g_rolloutWorkers[threadId].defenseValue[y][x];
+          }
 
-        // 敵の状態を更新
-        // updateCreepState();
+          if(sum > 0){
+            g_cellDefenseValue[y][x] += sum / threat->reachCount;
+            markBuildValueDirty(y, x);
+          }
+        }
+      }
 
-				turn += 1;
+      double maxProb = 0.0;
+      for(int baseId = 0; baseId < g_baseCount; baseId++){
+        maxProb = max(maxProb, threat->breachProbability[baseId]);
       }
 
-      return NOT_REACH;
-    }     
+      for(int baseId = 0; baseId < g_baseCount; baseId++){
+        double prob = threat->breachProbability[baseId];
+        if(prob <= 0.0) continue;
+
+        updateDefenseValue(getBase(baseId), 5, (int)(g_healthRate * g_creepHealth * prob / maxProb));
+      }
+    }
 
     /**
      * @fn [maybe]
-     *   各出現ポイントから基地までの最短経路を計算
+     *   各セルから基地までの最短経路を計算
      *
      * @detail
      * 最短経路を計算しておき、敵が出現した際に狙われる基地をリストアップ出来るように
      * しておく。ここでの最短経路は「マンハッタン距離」より長くならない経路を指す
      */
     void initCellToBaseShortestPath(){
-      // 全てのセルを始点
-      for(int y = 0; y < g_boardHeight; y++){
-        for(int x = 0; x < g_boardWidth; x++){
-          CELL *cell = getCell(y, x);
+      vector<unsigned int> targetBaseMasks(g_spawnCount);
 
-          if(cell->isPath()){
-            calcToBaseShortestPath(y, x);
-          }
-          if(cell->isSpawnPoint()){
-            calcSpawnToBaseShortestPath(cell->spawnId, y, x);
+      // 基地毎の逆向きの幅優先探索と出現ポイント毎の幅優先探索は独立しているので、スレッドで分担する
+      g_rolloutPool.run(g_baseCount + g_spawnCount, [&](int /*threadId*/, int taskId){
+        if(taskId < g_baseCount){
+          calcBaseShortestPath(taskId);
+        }else{
+          SPAWN *spawn = getSpawn(taskId - g_baseCount);
+          targetBaseMasks[spawn->id] = calcTargetBaseMask(spawn->y, spawn->x);
+        }
+      });
+
+      // 複数の基地や出現ポイントが書き込むセルの情報は、スレッドの数に依らないようにID順にまとめる
+      for(int baseId = 0; baseId < g_baseCount; baseId++){
+        registBaseShortestPath(baseId);
+      }
+      for(int spawnId = 0; spawnId < g_spawnCount; spawnId++){
+        for(int baseId = 0; baseId < g_baseCount; baseId++){
+          if(targetBaseMasks[spawnId] & (1 << baseId)){
+            g_targetedBasePoint[baseId] += 1;
           }
         }
       }
+
+      updateCorridor();
     }
 
     /**
      * @fn [maybe]
-     * 出現ポイントから基地までの最短経路を出す
-     * @param (fromY) 開始地点のY座標
-     * @param (fromX) 開始地点のX座標
+     * 基地から逆向きに幅優先探索を行い、各セルから基地までの歩数と最短路の方向を求める
+     * @param (baseId) 基地のID
      * @sa initCellToBaseShortestPath
      *
-     * @detail 
-     * 最短距離は幅優先探索で出す
+     * @detail
+     * 経路のセルだけを通る(他の基地は通り抜けられないので入らない)探索で各セルの歩数を求め、
+     * 1歩で歩数が1減る方向の中で番号が一番小さいものを最短路の方向(g_baseShortestDir)とする。
+     * 歩数の近い順(基地自身は除く)のリストはg_baseRouteOrderに残す。
+     * この基地の分の配列にしか書き込まないので、別の基地と同時に呼んでも良い
      */
-    void calcToBaseShortestPath(int fromY, int fromX){
-      map<int, bool> checkList;
-      queue<COORD> que;
-      que.push(COORD(fromY, fromX, 0));
+    void calcBaseShortestPath(int baseId){
+      BASE *base = getBase(baseId);
+      g_baseDist[baseId][base->y][base->x] = 0;
 
-      // 前回行動した情報のリセット
-      memset(g_prevStep, UNDEFINED, sizeof(g_prevStep));
+      int visitCount = bfs(base->y, base->x,
+        [&](const COORD &/*coord*/){
+          return true;
+        },
+        [&](int ny, int nx, int /*direct*/, int dist){
+          if(!isPathType(g_cellType[ny][nx])) return false;
 
-      while(!que.empty()){
-        // 座標情報の取得
-        COORD coord = que.front(); que.pop();
+          g_baseDist[baseId][ny][nx] = dist;
+          return true;
+        });
 
-        // セル情報を取得
-        CELL *cell = getCell(coord.y, coord.x);
+      g_baseRouteOrderCount[baseId] = 0;
 
-        assert(cell->isNotPlain());
+      for(int i = 1; i < visitCount; i++){
+        int y = g_bfsQueue[i].y;
+        int x = g_bfsQueue[i].x;
+        int dist = g_baseDist[baseId][y][x];
 
-        // 基地に辿り着いてそれがマンハッタン距離と同等の場合は経路を復元して登録を行う
-        if(cell->isBasePoint() && coord.dist <= calcManhattanDist(fromY, fromX, coord.y, coord.x)){
-          int baseId = cell->baseId;
-          // 最短経路の登録
-          registShortestPath(fromY, fromX, baseId, isEdgeOfMap(fromY, fromX));
-        }else{
-          for(int direct = 0; direct < 4; direct++){
-            int ny = coord.y + DY[direct];
-            int nx = coord.x + DX[direct];
-            int nz = calcZ(ny, nx);
-
-            // 行動出来るセルであれば進む
-            // が、もしチェックしたセルであれば処理を飛ばす
-            if(canMoveCell(ny, nx) && !checkList[nz]){
-              checkList[nz] = true;
-              que.push(COORD(ny, nx, coord.dist+1));
-              g_prevStep[ny][nx] = direct;
-            }
-          }
+        for(int direct = 0; direct < 4; direct++){
+          int ny = y + DY[direct];
+          int nx = x + DX[direct];
+
+          if(isOutsideMap(ny, nx) || g_baseDist[baseId][ny][nx] != dist-1) continue;
+
+          g_baseShortestDir[baseId][y][x] = direct;
+          break;
+        }
+
+        assert(g_baseShortestDir[baseId][y][x] != UNDEFINED);
+        g_baseRouteOrder[baseId][g_baseRouteOrderCount[baseId]++] = COORD(y, x, dist);
+      }
+    }
+
+    /**
+     * @fn [maybe]
+     * 基地への最短経路を登録する
+     * @param (baseId) 基地のID
+     * @sa calcBaseShortestPath
+     *
+     * @detail
+     * 歩数がマンハッタン距離と同じセルからは、方向の番号が小さい方を優先して進む経路が
+     * 各セルから幅優先探索した時の経路と一致するので、
+     *   - g_shortestPathMap  最短路の方向の中で番号が一番小さい方向(g_baseShortestDir)
+     *   - basePaths          この基地の経路になっているか
+     *   - g_cellPathCount    マップの端のセルから進んだ経路が通る数
+     * を歩数の遠い順にまとめて登録する
+     */
+    void registBaseShortestPath(int baseId){
+      static int edgeCount[MAX_N][MAX_N];
+
+      BASE *base = getBase(baseId);
+
+      for(int i = 0; i < g_baseRouteOrderCount[baseId]; i++){
+        edgeCount[g_baseRouteOrder[baseId][i].y][g_baseRouteOrder[baseId][i].x] = 0;
+      }
+
+      // 基地から遠い順に、マップの端から来た経路の数を次のセルに流す
+      for(int i = g_baseRouteOrderCount[baseId]-1; i >= 0; i--){
+        int y = g_baseRouteOrder[baseId][i].y;
+        int x = g_baseRouteOrder[baseId][i].x;
+
+        if(g_baseDist[baseId][y][x] != calcManhattanDist(y, x, base->y, base->x)) continue;
+
+        int direct = g_baseShortestDir[baseId][y][x];
+
+        g_shortestPathMap[y][x][baseId] = direct;
+        g_board[y][x].basePaths |= (1 << baseId);
+
+        if(isEdgeOfMap(y, x)){
+          edgeCount[y][x] += 1;
         }
+        g_cellPathCount[y][x] += edgeCount[y][x];
+        edgeCount[y + DY[direct]][x + DX[direct]] += edgeCount[y][x];
       }
     }
 
     /**
      * @fn [maybe]
-     * 出現ポイントから基地までの最短経路を出す
-     * @param (fromY) 開始地点のY座標
-     * @param (fromX) 開始地点のX座標
+     * 出現ポイントから狙われる基地を調べる
+     * @param (fromY)   開始地点のY座標
+     * @param (fromX)   開始地点のX座標
      * @sa initCellToBaseShortestPath
      *
+     * @return 狙われる基地(baseId番目のビット)
      * @detail 
-     * 最短距離は幅優先探索で出す
+     * 幅優先探索でマンハッタン距離と同じ距離で辿り着いた基地を狙われる基地とする。
+     * 盤面には書き込まないので、別の出現ポイントと同時に呼んでも良い
      */
-    void calcSpawnToBaseShortestPath(int spawnId, int fromY, int fromX){
-      assert(spawnId != UNDEFINED);
-      /*
-			int checkList[MAX_N][MAX_N];
-      memset(checkList, UNDEFINED, sizeof(checkList));
-			/*/
-      map<int, bool> checkList;
-			//*/
-      queue<ROUTE> que;
-      ROUTE start(fromY, fromX, 0);
-      que.push(start);
+    unsigned int calcTargetBaseMask(int fromY, int fromX){
+      unsigned int targetBaseMask = 0;
 
-      while(!que.empty()){
-        // 座標情報の取得
-        ROUTE route = que.front(); que.pop();
+      bfs(fromY, fromX,
+        [&](const COORD &coord){
+          int y = coord.y;
+          int x = coord.x;
 
-        // セル情報を取得
-        CELL *cell = getCell(route.y, route.x);
+          assert(getCell(y, x)->isNotPlain());
 
-        assert(cell->isNotPlain());
-
-        // 基地に辿り着いてそれがマンハッタン距離と同等の場合は経路を復元して登録を行う
-        if(cell->isBasePoint() && route.dist <= calcManhattanDist(fromY, fromX, route.y, route.x)){
-					g_targetedBasePoint[cell->baseId] += 1;
-          // 最短経路の登録
-          registPath(spawnId, route.routes);
-        }else{
-          for(int direct = 0; direct < 4; direct++){
-            int ny = route.y + DY[direct];
-            int nx = route.x + DX[direct];
-
-            // 行動出来るセルであれば進む
-            // が、もしチェックしたセルであれば処理を飛ばす
-						//*
-            int nz = calcZ(ny, nx);
-            if(canMoveCell(ny, nx) && !checkList[nz]){
-              checkList[nz] = true; 
-						/*/
-            if(canMoveCell(ny, nx) && (checkList[ny][nx] == UNDEFINED || (route.dist+1) <= checkList[ny][nx])){
-              if(checkList[ny][nx] == UNDEFINED){
-                checkList[ny][nx] = route.dist+1;
-              }else{
-                checkList[ny][nx] = min(checkList[ny][nx], route.dist+1);
-              }
-							//*/
-              ROUTE next(ny, nx, route.dist+1);
-              next.routes = route.routes;
-              next.routes.push_back(COORD(ny, nx));
-              que.push(next);
+          if(g_cellType[y][x] == BASE_POINT){
+            // マンハッタン距離と同等の距離で辿り着いた基地は狙われる
+            if(coord.dist <= calcManhattanDist(fromY, fromX, y, x)){
+              targetBaseMask |= (1 << g_board[y][x].baseId);
             }
+            return false;
           }
+
+          return true;
+        },
+        [&](int ny, int nx, int /*direct*/, int /*dist*/){
+          // 行動出来るセルであれば進む
+          return canMoveCell(ny, nx);
+        });
+
+      return targetBaseMask;
+    }
+
+    /**
+     * @fn [maybe]
+     * 基地に向かう敵が、タワーの攻撃が届かないまま進める区間を更新する
+     *
+     * @detail
+     * 基地毎の最短路(g_shortestPathMap)を基地に近い順に見て、次のセルが攻撃の届かない経路のセルなら
+     * 次のセルの区間に1つ足して区間の最後のセルを引き継ぐ。次のセルが攻撃の届くセルか基地なら区間は0にする。
+     * 先読みの敵はこの区間を1回でまとめて進む。タワーを建てる毎に呼ぶ(基地の数 × 経路のあるセルの数)
+     */
+    void updateCorridor(){
+      for(int baseId = 0; baseId < g_baseCount; baseId++){
+        int orderCount = g_baseRouteOrderCount[baseId];
+
+        for(int i = 0; i < orderCount; i++){
+          int y = g_baseRouteOrder[baseId][i].y;
+          int x = g_baseRouteOrder[baseId][i].x;
+          int direct = g_shortestPathMap[y][x][baseId];
+
+          g_corridorLength[baseId][y][x] = 0;
+          g_corridorExit[baseId][y][x] = packCoord(y, x);
+
+          if(direct == UNDEFINED) continue;
+
+          int ny = y + DY[direct];
+          int nx = x + DX[direct];
+
+          if(g_cellType[ny][nx] == BASE_POINT || g_simState.cellDamage[ny][nx] > 0) continue;
+
+          g_corridorLength[baseId][y][x] = g_corridorLength[baseId][ny][nx] + 1;
+          g_corridorExit[baseId][y][x] = g_corridorExit[baseId][ny][nx];
         }
       }
     }
 
-
     /**
      * @fn [maybe]
-     * 最短経路の登録を行う
-     * @param (spawnId) スポーン地点のID
-     * @param (baseId)  基地のID
+     * タワーを建てた時に、基地に向かう敵が基地に着くまでに受ける攻撃力の合計を更新する
+     * @param (towerY) 建てたタワーのY座標
+     * @param (towerX) 建てたタワーのX座標
+     * @param (range)  建てたタワーの射程距離
      *
      * @detail
-     * マップに「このセルからこの基地へはこの方角が最短ですよ」情報を書き込む
-     * 各Cellに「この基地への最短路の経路になってます」情報を書き込む
-     */
-    void registShortestPath(int destY, int destX, int baseId, bool isSpawnPoint = false){
-      BASE  *base = getBase(baseId);
-      int y = base->y;
-      int x = base->x;
-
-      CELL *cell;
-
-      // 逆算して最短路の登録を行う
-      while(y != destY || x != destX){
-        int prev = g_prevStep[y][x];
-        assert(prev != UNDEFINED);
-        y += DY[(prev+2)%4];
-        x += DX[(prev+2)%4];
-
-				assert(isInsideMap(y, x));
-        cell = getCell(y,x);
-        g_shortestPathMap[y][x][baseId] = prev;
-        cell->basePaths.insert(baseId);
-
-        if(isSpawnPoint){
-          cell->pathCount += 1;
+     * 最短路(g_shortestPathMap)を基地に近い順に見て「次のセルの攻撃力 + 次のセルの合計」を取る。
+     * 合計が変わるのは攻撃力が変わったセル(タワーの射程内)より基地から遠いセルだけなので、
+     * 射程内のセルの中で基地に一番近い歩数より近いセルは見直さない
+     */
+    void updateRouteDamage(int towerY, int towerX, int range){
+      for(int baseId = 0; baseId < g_baseCount; baseId++){
+        int orderCount = g_baseRouteOrderCount[baseId];
+        int minDist = INT_MAX;
+
+        for(int y = max(0, towerY - range); y <= min(g_boardHeight-1, towerY + range); y++){
+          for(int x = max(0, towerX - range); x <= min(g_boardWidth-1, towerX + range); x++){
+            if(g_baseDist[baseId][y][x] != UNDEFINED){
+              minDist = min(minDist, g_baseDist[baseId][y][x]);
+            }
+          }
+        }
+
+        for(int i = 0; i < orderCount; i++){
+          int y = g_baseRouteOrder[baseId][i].y;
+          int x = g_baseRouteOrder[baseId][i].x;
+          if(g_baseRouteOrder[baseId][i].dist < minDist) continue;
+
+          int direct = g_shortestPathMap[y][x][baseId];
+          g_routeDamage[baseId][y][x] = 0;
+
+          if(direct == UNDEFINED) continue;
+
+          int ny = y + DY[direct];
+          int nx = x + DX[direct];
+
+          if(g_cellType[ny][nx] == BASE_POINT) continue;
+
+          g_routeDamage[baseId][y][x] = g_simState.cellDamage[ny][nx] + g_routeDamage[baseId][ny][nx];
         }
       }
-      cell = getCell(destY, destX);
-      cell->basePaths.insert(baseId);
     }
 
     /**
      * @fn [maybe]
-     * 最短経路の登録を行う
-     * @param (spawnId) スポーン地点のID
-     * @param (baseId)  基地のID
+     * 敵が基地に着くまでのターン数と、着いた時の体力を距離場から求める
+     * @param (creepId)   敵ID
+     * @param (baseId)    基地ID
+     * @param (health)    狙われるのがこの敵だけの場合に、基地に着いた時の体力(0以下なら倒される)
+     *
+     * @return 基地に着くまでのターン数
+     */
+    int predictArrival(int creepId, int baseId, int *health){
+      int y = g_simState.creepY[creepId];
+      int x = g_simState.creepX[creepId];
+      assert(g_baseDist[baseId][y][x] != UNDEFINED);
+
+      *health = g_simState.creepHp[creepId] - g_routeDamage[baseId][y][x];
+
+      return g_baseDist[baseId][y][x];
+    }
+
+    /**
+     * @fn [maybe]
+     * 先読みの間に基地に着く可能性のある敵を距離場で数える
+     * @param (horizon) 先読みするターン数
+     * @param (threat)  数の書き込み先
      *
      * @detail
-     * マップに「このセルからこの基地へはこの方角が最短ですよ」情報を書き込む
-     * 各Cellに「この基地への最短路の経路になってます」情報を書き込む
+     * 敵は狙う基地(今いるセルから最短路で向かえる基地のどれか)に1ターン1歩進むので、
+     * どの候補の基地も先読みのターン数より遠い敵は基地に着かない。
+     * タワーは一番近い敵を撃つので、生きている敵が1体だけなら経路上の全ての攻撃を受ける。
+     * その場合は、どの候補の基地に着くまでにも倒される敵も基地に着かない
      */
-    void registPath(int spawnId, vector<COORD> routes){
-      int size = routes.size();
+    void countNearCreeps(int horizon, THREAT_INFO *threat){
+      int limit = min(horizon, LIMIT_TURN - g_currentTurn);
+      int aliveCount = g_simState.alive.count;
 
-      for(int i = 0; i < size; i++){
-        COORD coord = routes[i];
-        CELL *cell = getCell(coord.y, coord.x);
-        cell->spawnPaths.insert(spawnId);
+      threat->nearCreepCount = 0;
+
+      for(int i = 0; i < aliveCount; i++){
+        int creepId = g_simState.alive.ids[i];
+        unsigned int mask = g_board[g_simState.creepY[creepId]][g_simState.creepX[creepId]].basePaths;
+        bool isNear = false;
+
+        for(; mask > 0; mask &= mask - 1){
+          int health;
+          int turn = predictArrival(creepId, __builtin_ctz(mask), &health);
+
+          isNear |= (turn <= limit && (aliveCount > 1 || health > 0));
+        }
+
+        threat->nearCreepCount += isNear;
       }
     }
 
@@ -1145,7 +3342,6 @@ class PathDefense{
      * @fn [maybe]
      * 敵の作成を行う
      * @param (creepId) creepのID 
-     * @param (health)  体力
      * @param (y)       敵のY座標
      * @param (x)       敵のX座標
      *
@@ -1153,7 +3349,7 @@ class PathDefense{
      * @detail
      * 敵の作成を行い、敵の総数のカウントを1増やす
      */
-    CREEP createCreep(int creepId, int health, int y, int x){
+    CREEP createCreep(int creepId, int y, int x){
       // セル情報の取得
       CELL *cell = getCell(y,x);
 
@@ -1163,11 +3359,8 @@ class PathDefense{
       SPAWN *spawn = getSpawn(cell->spawnId);
 
       // 敵のインスタンスを作成
-      CREEP creep(creepId, health, y, x);
+      CREEP creep(creepId);
 
-      // もし500ターン毎に体力が倍々に増える
-      creep.health *= (1 << (g_currentTurn/500));
-      
       // 現在のターン時に出現したことを記録
       creep.created_at = g_currentTurn;
 
@@ -1272,12 +3465,14 @@ class PathDefense{
      * @detail 建設情報もここで追加を行う
      */
     void buildTower(int towerType, int y, int x){
+      PROFILE_SCOPE(PHASE_BUILD_TOWER);
+
       //fprintf(stderr,"buildTower type: %d\n", towerType);
       TOWER tower = buyTower(towerType);
       tower.id  = g_buildedTowerCount;
       tower.y   = y;
       tower.x   = x;
-      CELL *cell = getCell(y, x);
+      assert(getCell(y, x)->isPlain());
 
       // 建設したタワーリストに追加
       g_buildedTowerList.push_back(tower);
@@ -1288,8 +3483,16 @@ class PathDefense{
       // セルの「攻撃ダメージ」を更新
       updateCellDamageData(tower.id);
 
+      // シミュレーション用の盤面にも追加
+      g_simState.addTower(y, x, tower.range, tower.damage);
+
+      // 攻撃の届かない区間と、基地に着くまでに受ける攻撃力の合計を更新
+      updateCorridor();
+      updateRouteDamage(y, x, tower.range);
+
       // セルの種別を(TOWER_POINT)に変更
-      cell->type = TOWER_POINT;
+      g_cellType[y][x] = TOWER_POINT;
+      markBuildValueDirty(y, x);
 
       // 建設情報の追加
       m_buildTowerData.push_back(tower.x);
@@ -1307,36 +3510,20 @@ class PathDefense{
      */
     void updateCellDamageData(int towerId){
       //fprintf(stderr,"updateCellDamageData =>\n");
-      queue<COORD> que;
-      map<int, bool> checkList;
       TOWER *tower = getTower(towerId);
-      que.push(COORD(tower->y, tower->x, 0));
 
-      while(!que.empty()){
-        COORD coord = que.front(); que.pop();
+      forEachCellInRange(tower->y, tower->x, tower->range, [&](int y, int x, int /*dist*/){
+        CELL *cell = getCell(y, x);
 
-        CELL *cell = getCell(coord.y, coord.x);
-        
         // 経路であれば攻撃力を更新
         if(cell->isPath()){
-          cell->basicDamage += tower->damage;
+          g_cellBasicDamage[y][x] += tower->damage;
           // 守りが堅くなったので守りの優先度は低くする
-          cell->basicValue = max(cell->basicValue - cell->damage, 0);
+          g_cellBasicValue[y][x] = max(g_cellBasicValue[y][x] - g_cellDamage[y][x], 0);
           //cell->basicValue = max(cell->basicValue - tower->damage, 0);
+          markBuildValueDirty(y, x);
         }
-
-        for(int direct = 0; direct < 4; direct++){
-          int ny = coord.y + DY[direct];
-          int nx = coord.x + DX[direct];
-          int z = calcZ(ny, nx);
-
-          // マップ内であり、未探索で、タワーの攻撃範囲内であれば追加
-          if(isInsideMap(ny, nx) && !checkList[z] && tower->isInsideAttackRange(ny, nx)){
-            checkList[z] = true;
-            que.push(COORD(ny, nx, coord.dist+1));
-          }
-        }
-      }
+      });
     }
 
     /**
@@ -1456,15 +3643,83 @@ class PathDefense{
     }
 
     /**
-     * @fn [complete]
-     * 画面外に出ていないかをチェック
-     * @param (y) Y座標
-     * @param (x) X座標
+     * @fn [maybe]
+     * 攻撃範囲内に含まれるマップ内のセルを近い順に処理する
+     * @param (fromY)  中心のY座標
+     * @param (fromX)  中心のX座標
+     * @param (range)  攻撃範囲
+     * @param (action) 各セルに対する処理 void(int y, int x, int dist) (distは距離の2乗)
+     *
+     * @detail
+     * initDiscKernelで作成した相対座標リストをマップでクリップしながら辿るだけなので、キューも訪問済みリストも使わない
+     */
+    template<class ACTION>
+    void forEachCellInRange(int fromY, int fromX, int range, ACTION action){
+      assert(0 <= range && range <= MAX_R);
+      const COORD *kernel = g_discKernel[range];
+      int size = g_discKernelSize[range];
+
+      for(int i = 0; i < size; i++){
+        int y = fromY + kernel[i].y;
+        int x = fromX + kernel[i].x;
+
+        if(isOutsideMap(y, x)) continue;
+
+        action(y, x, kernel[i].dist);
+      }
+    }
+
+    /**
+     * @fn [maybe]
+     * 幅優先探索を行う
+     * @param (fromY)    開始地点のY座標
+     * @param (fromX)    開始地点のX座標
+     * @param (visit)    セルをキューから取り出した時の処理 bool(const COORD &coord)
+     *                   falseを返した場合はそのセルから先には進まない
+     * @param (canEnter) 隣のセルをキューに追加するかどうかの判定 bool(int ny, int nx, int direct, int dist)
+     *                   マップ内で未訪問のセルに対してだけ呼ばれる(distは追加する場合の距離)
      *
-     * @return マップから出ているかどうかを返す
+     * @return 訪問したセルの数(g_bfsQueueに訪問した順番で残っている)
+     * @detail
+     * 訪問済みの判定は探索番号付きの配列で行うので、探索毎のメモリ確保や初期化は行わない。
+     * 各セルは高々1回しかキューに入らないのでキューも固定長の配列を使い回す。
+     * (探索の途中で別の探索を始めないこと。作業用の配列はスレッド毎なので、別のスレッドとは同時に探索出来る)
      */
-    inline bool isOutsideMap(int y, int x){
-      return (y < 0 || x < 0 || y >= g_boardHeight || x >= g_boardWidth);
+    template<class VISIT, class CAN_ENTER>
+    int bfs(int fromY, int fromX, VISIT visit, CAN_ENTER canEnter){
+      // 探索番号を更新(一周した場合は訪問済みリストを初期化)
+      if(g_checkListId == INT_MAX){
+        memset(g_checkList, 0, sizeof(g_checkList));
+        g_checkListId = 0;
+      }
+      int id = ++g_checkListId;
+
+      int head = 0;
+      int tail = 0;
+      g_checkList[fromY][fromX] = id;
+      g_bfsQueue[tail++] = COORD(fromY, fromX, 0);
+
+      while(head < tail){
+        COORD coord = g_bfsQueue[head++];
+        PROFILE_COUNT(COUNTER_BFS_NODES, 1);
+
+        if(!visit(coord)) continue;
+
+        for(int direct = 0; direct < 4; direct++){
+          int ny = coord.y + DY[direct];
+          int nx = coord.x + DX[direct];
+
+          // マップ外か訪問済みであれば処理を飛ばす
+          if(isOutsideMap(ny, nx) || g_checkList[ny][nx] == id) continue;
+
+          if(canEnter(ny, nx, direct, coord.dist+1)){
+            g_checkList[ny][nx] = id;
+            g_bfsQueue[tail++] = COORD(ny, nx, coord.dist+1);
+          }
+        }
+      }
+
+      return tail;
     }
 
     /**
@@ -1498,7 +3753,9 @@ class PathDefense{
      *   - 敵情報の更新
      *   - 基地情報の更新
      */
-    void updateBoardData(vector<int> &creeps, int money, vector<int> &baseHealth){
+    void updateBoardData(const vector<int> &creeps, int money, const vector<int> &baseHealth){
+      PROFILE_SCOPE(PHASE_UPDATE_BOARD_DATA);
+
       // 現在の所持金の更新
       g_currentAmountMoney = money;
 
@@ -1516,9 +3773,6 @@ class PathDefense{
       // 敵情報の更新
       updateCreepsData(creeps);
 
-      // 敵の狙う基地を決める
-      setTargetBase();
-
       // 基地情報の更新
       updateBasesData(baseHealth);
     }
@@ -1531,6 +3785,8 @@ class PathDefense{
      * 毎ターン防御価値は変化するので初期化を行っておく、基礎点は変えない
      */
     void resetCellDefenseValue(){
+      PROFILE_SCOPE(PHASE_RESET_CELL_DEFENSE_VALUE);
+
       // 全てのCellに対して処理を行う
       for(int y = 0; y < g_boardHeight; y++){
         for(int x = 0; x < g_boardWidth; x++){
@@ -1540,10 +3796,13 @@ class PathDefense{
           if(cell->isPlain()) continue;
 
           // 防御価値を0に初期化する
-          cell->defenseValue = 0;
+          if(g_cellDefenseValue[y][x] != 0){
+            g_cellDefenseValue[y][x] = 0;
+            markBuildValueDirty(y, x);
+          }
 
           // セルの攻撃力を元に戻す
-          cell->damage = cell->basicDamage;
+          g_cellDamage[y][x] = g_cellBasicDamage[y][x];
         }
       }
     }
@@ -1573,12 +3832,14 @@ class PathDefense{
      * @detail
      * 敵の生存リストを更新を行う
      */
-    void updateCreepsData(vector<int> &creeps){
+    void updateCreepsData(const vector<int> &creeps){
+      PROFILE_SCOPE(PHASE_UPDATE_CREEPS_DATA);
+
       //! 現在の敵の数
       int currentCreepCount = creeps.size() / 4;
 
       // 生存中の敵リストをリセット
-      g_aliveCreepsIdList.clear();
+      g_simState.alive.clear();
 
       // 各敵情報を更新する
       for(int i = 0; i < currentCreepCount; i++){
@@ -1591,165 +3852,15 @@ class PathDefense{
 
         // もしcreated_atが設定されていない場合は新しくcreepを作成する
         if(creep->created_at == UNDEFINED){
-          CREEP newCreep = createCreep(creepId, health, y, x);
-          newCreep.originHealth = health;
-          newCreep.originY      = y;
-          newCreep.originX      = x;
-
-          g_creepList[creepId] = newCreep;
-
-        // そうでない場合は各値を更新
-        }else{
-          creep->health       = health;
-          creep->originHealth = health;
-          creep->originY      = y;
-          creep->originX      = x;
-          creep->y            = y;
-          creep->x            = x;
-        }
-
-        // 生存中の敵リストに追加
-        g_aliveCreepsIdList.insert(creepId);
-      }
-    }
-
-    /**
-     * @fn [maybe]
-     * 仮想的に敵を行動させる
-     *
-     * @detail
-     * ボードのシミュレート予測を向上させる
-     */
-    void moveCreeps(){
-      //fprintf(stderr,"moveCreeps =>\n");
-      set<int>::iterator it = g_aliveCreepsIdList.begin();
-
-      // 生存中の全ての敵が行動する
-      while(it != g_aliveCreepsIdList.end()){
-        int creepId = (*it);
-        CREEP *creep = getCreep(creepId);
-
-        /*
-        fprintf(stderr,"%d step (%d, %d) => (%d, %d)\n",
-            creepId, creep->y, creep->x, creep->y + DY[direct], creep->x + DX[direct]);
-            */
-
-        int direct = g_shortestPathMap[creep->y][creep->x][creep->targetBase];
-        assert(direct != UNDEFINED);
-        creep->y += DY[direct];
-        creep->x += DX[direct];
-
-				assert(isInsideMap(creep->y, creep->x));
-        CELL *cell = getCell(creep->y, creep->x);
-        //cell->defenseValue += creep->health;
-        cell->defenseValue += cell->pathCount * creep->health;
-
-        it++;
-      }
-    }
-
-    /**
-     * @fn
-     * 敵に対して攻撃を行う
-     */
-    void attack(int creepId, int damage){
-      CREEP *creep = getCreep(creepId);
-      
-      // 敵に攻撃
-      creep->health -= damage;
-
-      // もしHPが0以下の場合は倒した
-      if(creep->isDead()){
-        creep->state = DEAD;
-        g_aliveCreepsIdList.erase(creep->id);
-      }
-    }
-
-    /**
-     * @fn
-     * タワーが敵に対して攻撃
-     */
-    void attackTowers(){
-      //fprintf(stderr,"attackTowers =>\n");
-
-      for(int towerId = 0; towerId < g_buildedTowerCount; towerId++){
-        TOWER *tower = getTower(towerId);
-
-        // 敵をロックしていた場合攻撃
-        if(tower->isLocked()){
-          //attack(tower->lockedCreepId, tower->damage);
-        }
-      }
-    }
-
-    /**
-     * @fn [maybe]
-     * タワー情報の更新を行う
-     * 
-     * @detail
-     * 主に次にロックする敵を決める
-     */
-    void updateTowerData(){
-      //fprintf(stderr,"updateTowerData =>\n");
-
-      for(int towerId = 0; towerId < g_buildedTowerCount; towerId++){
-        TOWER *tower = getTower(towerId);
-
-        // ロック情報を解除
-        tower->lockedCreepId = UNLOCK;
-
-        int creepId = searchMostNearCreepId(tower);
-
-        // 敵が見つかった場合はそれをロック
-        if(creepId != NOT_FOUND){
-          //fprintf(stderr,"tower locked %d\n", creepId);
-          tower->lockedCreepId = creepId;
-          attack(tower->lockedCreepId, tower->damage);
+          g_creepList[creepId] = createCreep(creepId, y, x);
         }
-      }
-    }
-    
-    /**
-     * 敵情報のリセット
-     */
-    void resetCreepData(){
-      set<int>::iterator it = g_aliveCreepsIdList.begin();
-
-      while(it != g_aliveCreepsIdList.end()){
-        int creepId = (*it);
-        CREEP *creep = getCreep(creepId);
-
-        /*
-        fprintf(stderr,"%d - %d reset: (%d, %d) => (%d, %d)\n", 
-            g_currentTurn, creepId, creep->y, creep->x, creep->originY, creep->originX);
-            */
-
-        creep->health = creep->originHealth;
-        creep->y      = creep->originY;
-        creep->x      = creep->originX;
-
 
-        it++;
+        // 観測した盤面に追加(体力は受け取った値が現在の値)
+        g_simState.addCreep(creepId, health, y, x);
       }
-    }
-
-    /**
-     * 敵情報の更新
-     */
-    void updateCreepState(){
-      set<int> tmp = g_aliveCreepsIdList;
-      set<int>::iterator it = tmp.begin();
-
-      while(it != tmp.end()){
-        int creepId = (*it);
-        CREEP *creep = getCreep(creepId);
-
-        if(creep->state == NON_STOP){
-          g_aliveCreepsIdList.erase(creepId);
-        }
 
-        it++;
-      }
+      // セル毎の敵のリストを作成
+      g_simState.rebuildCellCreepList();
     }
 
     /**
@@ -1760,7 +3871,7 @@ class PathDefense{
      * @detail
      * 基地情報の更新、体力が0になった基地は状態を「BROKEN」に変更
      */
-    void updateBasesData(vector<int> &baseHealth){
+    void updateBasesData(const vector<int> &baseHealth){
       g_allBaseBroken = true;
 
       assert(g_baseCount == baseHealth.size());
@@ -1771,6 +3882,7 @@ class PathDefense{
 
         // 体力を更新する
         base->health = baseHealth[baseId];
+        g_simState.baseHealth[baseId] = baseHealth[baseId];
 
         updateBaseState(base);
       }
@@ -1807,11 +3919,14 @@ class PathDefense{
         setBaseDefenseValue(baseId);
       }
 
+      // 歩き方の数は基地毎の配列にしか書き込まないので、スレッドで分担する
+      g_rolloutPool.run(g_baseCount, [&](int /*threadId*/, int baseId){
+        initBaseWalkCount(baseId);
+      });
+
       for(int y = 0; y < g_boardHeight; y++){
         for(int x = 0; x < g_boardWidth; x++){
-          CELL *cell = getCell(y, x);
-
-          cell->aroundPathCount = calcCrossPath(y, x);
+          g_cellAroundPathCount[y][x] = calcCrossPath(y, x);
         }
       }
     }
@@ -1859,127 +3974,119 @@ class PathDefense{
      */
     int updateCellDefenseValue(int y, int x){
 			assert(isInsideMap(y, x));
-      CELL *cell = getCell(y, x);
-
-      return cell->basicValue;
+      return g_cellBasicValue[y][x];
     }
 
     /**
      * @fn [maybe]
 		 * 防御の評価値を更新
-     * @param (y)			始点のY座標
-     * @param (x)			始点のX座標
+     * @param (base)  基地の情報ポインタ
      * @param (range) 範囲
 		 * @param (value) 評価値
+     *
+     * @detail
+     * 基地からrange歩以内の経路に「range歩以内でそのセルに辿り着く歩き方の数 * value」を加算する
+     * (歩き方の数はinitBaseWalkCountで計算済み)
      */
     void updateDefenseValue(BASE *base, int range, int value = 1){
-      map<int, bool> checkList;
-      queue<COORD> que;
-      que.push(COORD(base->y, base->x, 0));
-      double rate = 1.0;
+      assert(range <= MAX_R);
 
-      while(!que.empty()){
-        COORD coord = que.front(); que.pop();
-
-        if(coord.dist > range) continue;
-        CELL *cell = getCell(coord.y, coord.x);
-
-        if(cell->isPath()){
-          cell->defenseValue += rate * value;
-        }
-
-        for(int direct = 0 ; direct < 4; direct++){
-          int ny = coord.y + DY[direct];
-          int nx = coord.x + DX[direct];
-          int nz = calcZ(ny, nx);
+      bfs(base->y, base->x,
+        [&](const COORD &coord){
+          CELL *cell = getCell(coord.y, coord.x);
 
-          if(isInsideMap(ny, nx) & !checkList[nz]){
-            que.push(COORD(ny, nx, coord.dist+1));
+          if(cell->isPath()){
+            int walkCount = g_baseWalkCount[base->id][range][coord.y-base->y+MAX_R][coord.x-base->x+MAX_R];
+            g_cellDefenseValue[coord.y][coord.x] += walkCount * value;
+            markBuildValueDirty(coord.y, coord.x);
           }
-        }
-      }
+
+          return true;
+        },
+        [&](int /*ny*/, int /*nx*/, int /*direct*/, int dist){
+          return dist <= range;
+        });
     }
 
     /**
-     * @fn [not yet]
-     * 防御価値を設定(基地周辺)
+     * @fn [maybe]
+     * 基地から各セルまでrange歩以内で到達する歩き方の数を計算する
      * @param (baseId) 基地ID
      *
      * @detail
-     *   - 基地周辺の防御価値を高くする
+     * 同じセルを何度通っても良い(戻っても良い)歩き方を数える。マップの外には出ない。
+     * updateDefenseValueでの重み付けに使用する
      */
-    void setBaseDefenseValue(int baseId){
-      //! 基地周辺の距離
-      int LIMIT = 3;
+    void initBaseWalkCount(int baseId){
       BASE *base = getBase(baseId);
-      map<int, bool> checkList;
-      queue<COORD> que;
-      que.push(COORD(base->y, base->x, 0));
-
-      while(!que.empty()){
-        COORD coord = que.front(); que.pop();
-        int z = calcZ(coord.y, coord.x);
-
-        // LIMITを越えた場合はスキップ
-        if(coord.dist > LIMIT) continue;
-
-        // 既に訪れていた場合はスキップ
-        if(checkList[z]) continue;
-        checkList[z] = true;
+      const int W = 2*MAX_R+1;
+      int walk[W][W];
+      int nextWalk[W][W];
+      int total[W][W];
+
+      memset(walk, 0, sizeof(walk));
+      memset(total, 0, sizeof(total));
+      walk[MAX_R][MAX_R] = 1;
+
+      for(int range = 0; range <= MAX_R; range++){
+        // ちょうどrange歩の歩き方を累積していく
+        for(int dy = 0; dy < W; dy++){
+          for(int dx = 0; dx < W; dx++){
+            total[dy][dx] += walk[dy][dx];
+            g_baseWalkCount[baseId][range][dy][dx] = total[dy][dx];
+          }
+        }
 
-        CELL *cell = getCell(coord.y, coord.x);
+        // 1歩進める
+        memset(nextWalk, 0, sizeof(nextWalk));
+        for(int dy = 0; dy < W; dy++){
+          for(int dx = 0; dx < W; dx++){
+            if(walk[dy][dx] == 0) continue;
 
-        if(cell->isPath()){
-          cell->basicValue += g_creepHealth * 8;
-          //cell->defenseValue += coord.dist;
-        }
+            for(int direct = 0; direct < 4; direct++){
+              int ny = dy + DY[direct];
+              int nx = dx + DX[direct];
 
-        for(int direct = 0; direct < 4; direct++){
-          int ny = coord.y + DY[direct];
-          int nx = coord.x + DX[direct];
+              if(ny < 0 || nx < 0 || ny >= W || nx >= W) continue;
+              if(isOutsideMap(base->y+ny-MAX_R, base->x+nx-MAX_R)) continue;
 
-          if(isInsideMap(ny, nx)){
-            que.push(COORD(ny, nx, coord.dist+1));
+              nextWalk[ny][nx] += walk[dy][dx];
+            }
           }
         }
+        memcpy(walk, nextWalk, sizeof(walk));
       }
     }
 
     /**
-     * @fn
-		 * 敵の目的地をランダムに設定する
+     * @fn [not yet]
+     * 防御価値を設定(基地周辺)
+     * @param (baseId) 基地ID
+     *
+     * @detail
+     *   - 基地周辺の防御価値を高くする
      */
-    void setTargetBase(){
-      set<int>::iterator it = g_aliveCreepsIdList.begin();
+    void setBaseDefenseValue(int baseId){
+      //! 基地周辺の距離
+      int LIMIT = 3;
+      BASE *base = getBase(baseId);
 
-      while(it != g_aliveCreepsIdList.end()){
-        int creepId = (*it);
-        CREEP *creep = getCreep(creepId);
+      bfs(base->y, base->x,
+        [&](const COORD &coord){
+          CELL *cell = getCell(coord.y, coord.x);
 
-        int targetId = selectTargetBase(creepId);
-        creep->targetBase = targetId;
+          if(cell->isPath()){
+            g_cellBasicValue[coord.y][coord.x] += g_creepHealth * 8;
+            //g_cellDefenseValue[coord.y][coord.x] += coord.dist;
+          }
 
-        it++;
-      }
+          return true;
+        },
+        [&](int /*ny*/, int /*nx*/, int /*direct*/, int dist){
+          // LIMITを越えた場合はスキップ
+          return dist <= LIMIT;
+        });
     }
-		
-		/**
-		 * @fn [maybe]
-		 * 敵の目的地をランダムに設定する
-		 * @param (creepId) 敵のID
-		 *
-		 * @detail
-		 * あとでシミュレーションするときに使用する
-		 */
-		int selectTargetBase(int creepId){
-			CREEP *creep = getCreep(creepId);
-			CELL *cell = getCell(creep->y, creep->x);
-			set<int>::iterator it = cell->basePaths.begin();
-
-			advance(it, xor128() % cell->basePaths.size());
-      return (*it);
-		}
-		
 
     /**
      * @fn [maybe]
@@ -1988,25 +4095,32 @@ class PathDefense{
      * @param (money)      現在の所持金
      * @param (baseHealth) 基地の体力情報
      *
-     * @return タワーの建設情報
+     * @return タワーの建設情報(次に呼び出すまで有効)
      */
-    vector<int> placeTowers(vector<int> creeps, int money, vector<int> baseHealth){
+    const vector<int> &placeTowers(const vector<int> &creeps, int money, const vector<int> &baseHealth){
+      g_searchBudget.start();
       m_buildTowerData.clear();
 
       // ゲーム情報の更新
       updateBoardData(creeps, money, baseHealth);
 
-      g_tempAliveCreepsIdList = g_aliveCreepsIdList;
-
 			// 全ての基地が破壊されたか、お金が無いときは何も行動しない
       if(!g_giveup && (g_currentTurn < 1500 || !g_allBaseBroken) && g_currentAmountMoney >= g_towerMinCost){
-        for(int i = 0; i < 2 && g_currentAmountMoney >= g_towerMinCost; i++){
-      	  // 敵が生きているかどうかをチェック
-          int baseId = isAnyCreepReachableBase();
+        // このターンの持ち時間を決める
+        g_searchBudget.allocate(LIMIT_TURN - g_currentTurn);
+        double attemptCost = 0.0;
+
+        for(int i = 0; g_currentAmountMoney >= g_towerMinCost; i++){
+          // 必ず試す回数を超えたら、持ち時間に余裕がある時だけ続ける
+          if(i >= MIN_BUILD_ATTEMPT && (i >= MAX_BUILD_ATTEMPT || !g_searchBudget.canAfford(attemptCost))) break;
+          double startTime = g_searchBudget.elapsed();
+
+      	  // 敵が基地に到達しそうかどうかをロールアウトで調べる
+          THREAT_INFO threat;
+          int baseId = searchThreat(&threat);
 
       	  if(baseId != NOT_REACH){
-            BASE *base = getBase(baseId);
-            updateDefenseValue(base, 5, g_healthRate * g_creepHealth);
+            applyThreat(&threat);
         	  BUILD_INFO buildData = searchBestBuildPoint();
 
         	  if(canBuildTower(buildData.type, buildData.y, buildData.x)){
@@ -2016,8 +4130,7 @@ class PathDefense{
             break;
           }
 
-          g_aliveCreepsIdList = g_tempAliveCreepsIdList;
-          resetCreepData();
+          attemptCost = g_searchBudget.elapsed() - startTime;
         }
 			}
 
@@ -2028,6 +4141,8 @@ class PathDefense{
 				finalResult();
 			}
 
+      g_searchBudget.stop();
+
       // タワーの建設情報を返して終わり
       return m_buildTowerData;
     }
@@ -2050,222 +4165,576 @@ class PathDefense{
 			for(int baseId = 0; baseId < g_baseCount; baseId++){
 				fprintf(stderr,"Targeted Point %d = %d\n", baseId, g_targetedBasePoint[baseId]);
 			}
+
+      if(g_speculation.enabled){
+        fprintf(stderr,"Speculation hit = %d, miss = %d\n", g_speculation.hitCount, g_speculation.missCount);
+      }
+
+      // 計測結果(PATH_DEFENSE_PROFILE を定義した時だけ)
+      PROFILE_DUMP();
 		}
 
     /**
      * @fn [maybe]
-     * ある地点から生存中の敵で一番近い敵のIDを返す
-     * @param (tower) タワー情報
+     * 被覆行列の行を辿って、攻撃範囲毎に経路のセルの重みの合計を求める
+     * @param (z)            建てるセル(y*MAX_N+x)
+     * @param (weightConst)  攻撃範囲毎の重み(定数)の合計 [range]
+     * @param (weightDamage) 攻撃範囲毎の重み(攻撃力)の合計 [range]
      *
-     * @return 一番近い敵のID
      * @detail
-     * タワーが敵をロックするときに使う
+     * 行は距離の近い順なので、1回辿るだけで全ての攻撃範囲の合計が求まる。行同士は独立している
      */
-    int searchMostNearCreepId(TOWER *tower){
-      int mostNearCreepId = NOT_FOUND;
-      int roughDist;
-      int range = tower->range;
-      int minDist = INT_MAX;
+    void sumCoverWeight(int z, int *weightConst, int *weightDamage){
+      int i = g_coverRowStart[z];
+      int sumConst = 0;
+      int sumDamage = 0;
+
+      for(int range = 0; range <= MAX_R; range++){
+        int end = g_coverRowEnd[z][range];
+
+        for(; i < end; i++){
+          int column = g_coverColumn[i];
+          sumConst += g_coverWeightConst[column];
+          sumDamage += g_coverWeightDamage[column];
+        }
 
-      set<int>::iterator it = g_aliveCreepsIdList.begin();
+        weightConst[range] = sumConst;
+        weightDamage[range] = sumDamage;
+      }
+    }
 
-      // 生存中の敵をそれぞれ処理
-      while(it != g_aliveCreepsIdList.end()){
-        int creepId = (*it);
-        CREEP *creep = getCreep(creepId);
+    /**
+     * @fn
+     * この地点にタワーを建てた時の評価値を計算する
+     * @param (fromY)        出発地点のY座標
+     * @param (fromX)        出発地点のX座標
+     * @param (range)        攻撃範囲
+     * @param (damage)       攻撃力
+     * @param (weightConst)  攻撃範囲に入る経路のセルの重み(定数)の合計
+     * @param (weightDamage) 攻撃範囲に入る経路のセルの重み(攻撃力)の合計
+     *
+     * @return 評価値
+     * @detail
+     *   - 経路のセルは重み(updateCoverWeight)の分
+     *   - 経路以外のセル(基地、平地、タワー)は攻撃力の分だけ下げる
+     *   - 画面外をなるべく含めないように、マップの外に接する辺毎に下げる
+     */
+    int calcBuildValue(int fromY, int fromX, int range, int damage, int weightConst, int weightDamage){
+      PROFILE_COUNT(COUNTER_CALC_BUILD_VALUE, 1);
 
-        // 敵との距離を計算
-        roughDist = calcRoughDist(tower->y, tower->x, creep->y, creep->x);
+      int z = fromY * MAX_N + fromX;
+      int value = 0;
+			if(g_realTowerCount <= 1 && g_cellAroundPathCount[fromY][fromX] >= 3){
+				value += 10000 * g_cellAroundPathCount[fromY][fromX];
+			}
 
-        if(minDist > roughDist && roughDist <= range * range){
-          assert(creep->isNotDead());
-          minDist = roughDist;
-          mostNearCreepId = creepId;
-        }
+      value += weightConst + damage * (weightDamage - g_coverBlockCount[z][range]);
+      value -= g_coverEdgeCount[z][range] * (g_boardHeight/2);
 
-        it++;
-      }
+      return value;
+    }
+};
+
+/*
+ * PATH_DEFENSE_NO_MAIN を定義すると main を含めない(ベンチマーク用のドライバからソルバーを取り込む場合)
+ */
+#ifndef PATH_DEFENSE_NO_MAIN
+/**
+ * @brief 標準入力をまとめて読み込んで整数を取り出す
+ *
+ * @detail
+ * テスターは出力を受け取ってから次のターンの情報を書き込むので、fread等で大きさ分を待つと止まってしまう。
+ * readでその時点で届いている分だけを読み込み、足りなくなったら続きを読み込む
+ */
+typedef struct bufferedReader {
+  char buffer[1 << 16];   // 読み込んだデータ
+  int head;               // 次に読む位置
+  int tail;               // 読み込んだデータの終わり
+
+  bufferedReader(){
+    this->head = 0;
+    this->tail = 0;
+  }
+
+  /**
+   * @fn [complete]
+   * 次の1文字を返す(入力の終わりでは-1)
+   */
+  inline int nextChar(){
+    if(head == tail){
+      ssize_t size = read(0, buffer, sizeof(buffer));
+      if(size <= 0) return -1;
 
-      return mostNearCreepId;
+      head = 0;
+      tail = size;
     }
 
-    /**
-     * @fn [not yet]
-     * いずれかの敵が基地に到達したかどうかを調べる
-     */
-    int isAnyCreepReachBase(){
-      set<int>::iterator it = g_aliveCreepsIdList.begin();
+    return buffer[head++];
+  }
 
-      while(it != g_aliveCreepsIdList.end()){
-        int creepId = (*it);
-        CREEP *creep = getCreep(creepId);
-        CELL *cell = getCell(creep->y, creep->x);
-
-        if(cell->isBasePoint()){
-          //*
-          return cell->baseId;
-          /*/
-          BASE *base = getBase(cell->baseId);
-          if(base->isNotBroken()){
-          }
-          creep->state = NON_STOP;
-          //*/
-        }
+  /**
+   * @fn [complete]
+   * 空白を読み飛ばして最初の文字を返す
+   */
+  inline int skipSpace(){
+    int c = nextChar();
+    while(c == ' ' || c == '\n' || c == '\r' || c == '\t') c = nextChar();
+    return c;
+  }
 
-        it++;
-      }
+  /**
+   * @fn [complete]
+   * 整数を1つ読む
+   */
+  int nextInt(){
+    int c = skipSpace();
+    bool negative = (c == '-');
+    if(negative) c = nextChar();
+
+    int value = 0;
+    while('0' <= c && c <= '9'){
+      value = 10 * value + (c - '0');
+      c = nextChar();
+    }
+
+    return negative? -value : value;
+  }
+
+  /**
+   * @fn [complete]
+   * 空白で区切られた文字列を1つ読む
+   */
+  void nextToken(string &token){
+    token.clear();
 
-      return NOT_REACH;
+    int c = skipSpace();
+    while(c != -1 && c != ' ' && c != '\n' && c != '\r' && c != '\t'){
+      token += c;
+      c = nextChar();
     }
+  }
 
-    /**
-     * @fn
-     * ある地点からどれだけの経路をカバーできるかを計算
-     * @param (fromY) 出発地点のY座標
-     * @param (fromX) 出発地点のX座標
-     * @param (range) 攻撃範囲
-     *
-     * @return カバーしている経路の数
-     */
-    int calcCoverPathCount(int fromY, int fromX, int range){
-      int pathCount = 0;
+  /**
+   * @fn [complete]
+   * 整数をcount個読んでvaluesに入れる(容量は使い回す)
+   */
+  void nextInts(int count, vector<int> &values){
+    values.resize(count);
+
+    for(int i = 0; i < count; i++){
+      values[i] = nextInt();
+    }
+  }
+} BUFFERED_READER;
 
-      queue<COORD> que;
-      que.push(COORD(fromY, fromX, 0));
-      map<int, bool> checkList;
+/**
+ * @brief 1ターン分の出力を溜めて、まとめて書き出す
+ */
+typedef struct bufferedWriter {
+  char buffer[1 << 16];   // 書き出すデータ
+  int size;               // 溜まっている長さ
 
-      // 座標情報が無くなるまで繰り返す
-      while(!que.empty()){
-        COORD coord = que.front(); que.pop();
-        int z = calcZ(coord.y, coord.x);
+  bufferedWriter(){
+    this->size = 0;
+  }
 
-        // 調査済みの座標であれば処理を飛ばす
-        if(checkList[z]) continue;
-        checkList[z] = true;
+  /**
+   * @fn [complete]
+   * 整数を1行で書く
+   */
+  void writeLine(int value){
+    if(size + 16 > (int)sizeof(buffer)) flush();
 
-        // もし距離が攻撃範囲であれば処理を続ける
-        if(calcRoughDist(fromY, fromX, coord.y, coord.x) <= range * range){
-          CELL *cell = getCell(coord.y, coord.x);
+    if(value < 0){
+      buffer[size++] = '-';
+      value = -value;
+    }
 
-          // もしセルの種別が経路であればカバーする範囲を増やす
-          if(cell->isPath()){
-            pathCount += 1;
-          }
+    char digits[12];
+    int length = 0;
+    do{
+      digits[length++] = '0' + value % 10;
+      value /= 10;
+    }while(value > 0);
 
-          // 上下左右のセルを追加
-          for(int i = 0; i < 4; i++){
-            int ny = coord.y + DY[i];
-            int nx = coord.x + DX[i];
+    while(length > 0) buffer[size++] = digits[--length];
+    buffer[size++] = '\n';
+  }
 
-            // もし画面外で無い場合はキューに追加
-            if(isInsideMap(ny, nx)){
-              que.push(COORD(ny, nx));
-            }
-          }
-        }
-      }
+  /**
+   * @fn [complete]
+   * 溜まっている分を書き出す
+   */
+  void flush(){
+    int written = 0;
 
-      return pathCount;
+    while(written < size){
+      ssize_t result = write(1, buffer + written, size - written);
+      assert(result > 0);
+      written += result;
     }
+    size = 0;
+  }
+} BUFFERED_WRITER;
 
-    /**
-     * @fn
-     * この地点にタワーを建てた時の評価値を計算する
-     * @param (fromY) 出発地点のY座標
-     * @param (fromX) 出発地点のX座標
-     * @param (range) 攻撃範囲
-     *
-     * @return カバーしている経路の数
-     * @detail
-     * 「経路」のセルだけを評価対象にいれる
-     */
-    int calcBuildValue(int fromY, int fromX, int range, int damage){
-      int value = 0;
-			CELL *rootCell = getCell(fromY, fromX);
+/**
+ * @brief 入力と出力を記録するトレースファイルの書き込み
+ *
+ * @detail
+ * ファイルの形式(整数は全てzigzag符号化した可変長整数)
+ *   "PDTR" バージョン
+ *   行数 各行(長さ + 文字列) 初期所持金 敵の初期体力 報酬 タワーの情報(個数 + 値)
+ *   ターン毎に 所持金 敵の情報(個数 + 値) 基地の体力(個数 + 値) 建設情報(個数 + 値)
+ * ターン数はファイルの終わりまで
+ */
+typedef struct traceWriter {
+  FILE *fp;   // 書き込み先(記録しない場合はNULL)
 
-			if(g_realTowerCount <= 1 && rootCell->aroundPathCount >= 3){
-				value += 10000 * rootCell->aroundPathCount;
-			}
+  traceWriter(){
+    this->fp = NULL;
+  }
 
-      queue<COORD> que;
-      que.push(COORD(fromY, fromX, 0));
-      map<int, bool> checkList;
-      set<int> coverSpawnList;
+  ~traceWriter(){
+    if(fp != NULL) fclose(fp);
+  }
 
-      // 座標情報が無くなるまで繰り返す
-      while(!que.empty()){
-        COORD coord = que.front(); que.pop();
-        int z = calcZ(coord.y, coord.x);
+  /**
+   * @fn [complete]
+   * ファイルを開いてヘッダを書く
+   * @param (path) ファイルのパス
+   */
+  bool open(const char *path){
+    fp = fopen(path, "wb");
+    if(fp == NULL) return false;
 
-        // 調査済みの座標であれば処理を飛ばす
-        if(checkList[z]) continue;
-        checkList[z] = true;
+    fwrite("PDTR", 1, 4, fp);
+    writeInt(TRACE_VERSION);
+    return true;
+  }
 
-        // もし距離が攻撃範囲であれば処理を続ける
-        if(calcRoughDist(fromY, fromX, coord.y, coord.x) <= range * range){
-          CELL *cell = getCell(coord.y, coord.x);
+  /**
+   * @fn [complete]
+   * 整数を書く(zigzag符号化して7bitずつ)
+   */
+  void writeInt(int value){
+    unsigned int v = ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
 
-          if(cell->isPath()){
-						if(cell->basicDamage == 0){
-            	value += 4 * damage + cell->basicValue + cell->defenseValue + 2 * cell->pathCount;
-						}else{
-            	value += cell->basicValue + cell->defenseValue + damage * cell->pathCount - min(cell->basicDamage, g_creepHealth * 8);
-						}
-
-            set<int>::iterator it = cell->spawnPaths.begin();
-            while(it != cell->spawnPaths.end()){
-              coverSpawnList.insert(*it);
-              it++;
-            }
+    while(v >= 0x80){
+      fputc((v & 0x7f) | 0x80, fp);
+      v >>= 7;
+    }
+    fputc(v, fp);
+  }
 
-            if(cell->aroundPathCount > 2){
-              value += damage * (cell->aroundPathCount-1);
-            }
-					}else if(cell->isBasePoint()){
-            value -= damage;
-          }else if(cell->isPlain()){
-            value -= damage;
-          }else if(cell->isTowerPoint()){
-            value -= damage;
-					}
-
-          // 上下左右のセルを追加
-          for(int i = 0; i < 4; i++){
-            int ny = coord.y + DY[i];
-            int nx = coord.x + DX[i];
-
-            // もし画面外で無い場合はキューに追加
-            if(isInsideMap(ny, nx)){
-              que.push(COORD(ny, nx, coord.dist+1));
-            // 画面外をなるべく含めないように
-            }else{
-              value -= g_boardHeight/2;
-            }
-          }
-        }
+  /**
+   * @fn [complete]
+   * 整数の列を書く(個数 + 値)
+   */
+  void writeInts(const vector<int> &values){
+    writeInt(values.size());
+
+    for(int i = 0; i < values.size(); i++){
+      writeInt(values[i]);
+    }
+  }
+
+  /**
+   * @fn [complete]
+   * 初期化の情報を書く
+   */
+  void writeInit(const vector<string> &board, int money, int creepHealth, int creepMoney, const vector<int> &towerTypes){
+    if(fp == NULL) return;
+
+    writeInt(board.size());
+    for(int y = 0; y < board.size(); y++){
+      writeInt(board[y].size());
+      fwrite(board[y].data(), 1, board[y].size(), fp);
+    }
+    writeInt(money);
+    writeInt(creepHealth);
+    writeInt(creepMoney);
+    writeInts(towerTypes);
+  }
+
+  /**
+   * @fn [complete]
+   * 1ターン分の入力と出力を書く
+   */
+  void writeTurn(int money, const vector<int> &creeps, const vector<int> &baseHealth, const vector<int> &decision){
+    if(fp == NULL) return;
+
+    writeInt(money);
+    writeInts(creeps);
+    writeInts(baseHealth);
+    writeInts(decision);
+
+    // 途中で落ちても、そこまでのターンは再生出来るようにする
+    fflush(fp);
+  }
+} TRACE_WRITER;
+
+/**
+ * @brief トレースファイルの読み込み(ファイル全体をメモリに読んでから取り出す)
+ */
+typedef struct traceReader {
+  vector<unsigned char> data;   // ファイルの中身
+  int pos;                      // 次に読む位置
+
+  traceReader(){
+    this->pos = 0;
+  }
+
+  /**
+   * @fn [complete]
+   * ファイルを読み込んでヘッダを確認する
+   * @param (path) ファイルのパス
+   */
+  bool open(const char *path){
+    FILE *fp = fopen(path, "rb");
+    if(fp == NULL) return false;
+
+    unsigned char chunk[1 << 16];
+    size_t size;
+    while((size = fread(chunk, 1, sizeof(chunk), fp)) > 0){
+      data.insert(data.end(), chunk, chunk + size);
+    }
+    fclose(fp);
+
+    if(data.size() < 4 || memcmp(data.data(), "PDTR", 4) != 0) return false;
+    pos = 4;
+
+    int version;
+    return readInt(&version) && version == TRACE_VERSION;
+  }
+
+  /**
+   * @fn [complete]
+   * 最後まで読んだかどうか
+   */
+  bool atEnd(){
+    return pos >= data.size();
+  }
+
+  /**
+   * @fn [complete]
+   * 整数を読む
+   * @param (value) 読んだ値の書き込み先
+   *
+   * @return 読めたかどうか(ファイルの終わりに達した、32bitに収まらない場合はfalse)
+   */
+  bool readInt(int *value){
+    unsigned int v = 0;
+    int shift = 0;
+
+    while(true){
+      if(pos >= data.size() || shift > 28) return false;
+      unsigned int byte = data[pos++];
+      v |= (byte & 0x7f) << shift;
+      if(byte < 0x80) break;
+      shift += 7;
+    }
+
+    *value = (int)(v >> 1) ^ -(int)(v & 1);
+    return true;
+  }
+
+  /**
+   * @fn [complete]
+   * 整数の列を読む(容量は使い回す)
+   *
+   * @return 読めたかどうか
+   */
+  bool readInts(vector<int> &values){
+    int count;
+    // 値は1つ1byte以上なので、残りのbyte数より多い個数は壊れている
+    if(!readInt(&count) || count < 0 || count > data.size() - pos) return false;
+    values.resize(count);
+
+    for(int i = 0; i < count; i++){
+      if(!readInt(&values[i])) return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * @fn [complete]
+   * 文字列を読む
+   *
+   * @return 読めたかどうか
+   */
+  bool readString(string &value){
+    int length;
+    if(!readInt(&length) || length < 0 || length > data.size() - pos) return false;
+
+    value.assign((const char*)data.data() + pos, length);
+    pos += length;
+
+    return true;
+  }
+} TRACE_READER;
+
+/**
+ * @fn [maybe]
+ * トレースファイルの入力でソルバーを動かし、記録した出力と一致するかとターン毎の時間を調べる
+ * @param (path) トレースファイルのパス
+ *
+ * @return 終了コード(全てのターンで一致すれば0)
+ * @detail
+ * ソルバーは持ち時間に応じて探索を変えるので、一致を確認する場合は記録も再生も
+ * -DPATH_DEFENSE_TIME_LIMIT=0 でコンパイルしたもので行う
+ */
+int replayTrace(const char *path){
+  TRACE_READER reader;
+  if(!reader.open(path)){
+    fprintf(stderr, "cannot read trace %s\n", path);
+    return 1;
+  }
+
+  int height;
+  int money;
+  int creepHealth;
+  int creepMoney;
+  vector<int> towerType;
+  bool valid = reader.readInt(&height) && 0 <= height && height <= MAX_N;
+  vector<string> board(valid? height : 0);
+
+  for(int y = 0; y < board.size() && valid; y++){
+    valid = reader.readString(board[y]);
+  }
+  valid = valid && reader.readInt(&money) && reader.readInt(&creepHealth) && reader.readInt(&creepMoney);
+  valid = valid && reader.readInts(towerType);
+
+  if(!valid){
+    fprintf(stderr, "trace %s is truncated before the first turn\n", path);
+    return 1;
+  }
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  PathDefense pd;
+  pd.init(board, money, creepHealth, creepMoney, towerType);
+  double initTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+  vector<int> creeps;
+  vector<int> baseHealth;
+  vector<int> expected;
+  vector<double> turnTimes;
+  int mismatchCount = 0;
+
+  while(!reader.atEnd()){
+    // 記録の途中で落ちたトレースは、最後まで書けたターンだけを再生する
+    if(!reader.readInt(&money) || !reader.readInts(creeps) || !reader.readInts(baseHealth) || !reader.readInts(expected)){
+      fprintf(stderr, "trace truncated at turn %d\n", (int)turnTimes.size());
+      break;
+    }
+
+    start = chrono::steady_clock::now();
+    const vector<int> &ret = pd.placeTowers(creeps, money, baseHealth);
+    turnTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+
+    if(ret != expected){
+      if(mismatchCount == 0){
+        fprintf(stderr, "turn %d: decision differs from the trace\n", (int)turnTimes.size() - 1);
       }
+      mismatchCount += 1;
+    }
+  }
 
-      return value;
+  int turnCount = turnTimes.size();
+  double totalTime = 0.0;
+  for(int turn = 0; turn < turnCount; turn++){
+    totalTime += turnTimes[turn];
+  }
+  sort(turnTimes.begin(), turnTimes.end());
+
+  double p50 = (turnCount > 0)? turnTimes[turnCount / 2] : 0.0;
+  double p99 = (turnCount > 0)? turnTimes[min(turnCount - 1, turnCount * 99 / 100)] : 0.0;
+  double maxTime = (turnCount > 0)? turnTimes[turnCount - 1] : 0.0;
+
+  printf("REPLAY turns=%d init=%.3fms total=%.3fms p50=%.3fms p99=%.3fms max=%.3fms mismatches=%d\n",
+      turnCount, initTime, initTime + totalTime, p50, p99, maxTime, mismatchCount);
+
+  return (mismatchCount == 0)? 0 : 1;
+}
+
+BUFFERED_READER g_reader;
+BUFFERED_WRITER g_writer;
+
+/*
+ * 引数無しで実行するとテスターと標準入出力でやりとりする
+ *   -record FILE  やりとりした入出力をトレースファイルに記録する
+ *   -replay FILE  トレースファイルの入力で実行して、出力の一致とターン毎の時間を調べる
+ */
+int main(int argc, char **argv){
+  TRACE_WRITER trace;
+  bool speculate = false;
+
+  for(int i = 1; i < argc; i++){
+    string arg = argv[i];
+
+    if(arg == "-replay" && i+1 < argc){
+      return replayTrace(argv[++i]);
+    }else if(arg == "-speculate"){
+      speculate = true;
+    }else if(arg == "-record" && i+1 < argc){
+      if(!trace.open(argv[++i])){
+        fprintf(stderr, "cannot write trace %s\n", argv[i]);
+        return 1;
+      }
+    }else{
+      fprintf(stderr, "unknown argument %s\n", argv[i]);
+      return 1;
     }
-};
+  }
+
+  int n = g_reader.nextInt();
+  int money = g_reader.nextInt();
+
+  string row;
+  vector<string> board;
+  for(int y = 0; y < n; y++){
+    g_reader.nextToken(row);
+    board.push_back(row);
+  }
+
+  int creepHealth = g_reader.nextInt();
+  int creepMoney = g_reader.nextInt();
+
+  vector<int> towerType;
+  g_reader.nextInts(g_reader.nextInt(), towerType);
+
+  trace.writeInit(board, money, creepHealth, creepMoney, towerType);
+
+  PathDefense pd;
+  pd.init(board, money, creepHealth, creepMoney, towerType);
+  if(speculate) pd.enableSpeculation();
+
+  // 毎ターン使い回す
+  vector<int> creeps;
+  vector<int> baseHealth;
 
-int main(){
-  int n, nc, b, money, creepHealth, creepMoney, nt;string row;vector<string> board;
-  cin >> n;
-  cin >> money;for(int y = 0; y < n; y++){cin >> row; board.push_back(row);}
-  cin >> creepHealth;
-  cin >> creepMoney;
-  cin >> nt;
-  vector<int> towerType(nt);
-  for(int i = 0; i < nt; i++){cin >> towerType[i];}
-  PathDefense pd;pd.init(board, money, creepHealth, creepMoney, towerType);
   for(int turn = 0; turn < LIMIT_TURN; turn++){
-    //fprintf(stderr,"turn = %d\n", turn);
-    cin >> money;
-    cin >> nc;vector<int> creeps(nc);
-    for(int creepId = 0; creepId < nc; creepId++){cin >> creeps[creepId];}
-    cin >> b;vector<int> baseHealth(b);
-    for(int baseId = 0; baseId < b; baseId++){cin >> baseHealth[baseId];}
-    vector<int> ret = pd.placeTowers(creeps, money, baseHealth);
-    cout << ret.size() << endl;
-    for(int i = 0; i < ret.size(); i++){cout << ret[i] << endl;}}return 0;}
+    money = g_reader.nextInt();
+    g_reader.nextInts(g_reader.nextInt(), creeps);
+    g_reader.nextInts(g_reader.nextInt(), baseHealth);
+
+    // 入力が揃ったので、合間の先読みを止める
+    pd.finishSpeculation();
+
+    const vector<int> &ret = pd.placeTowers(creeps, money, baseHealth);
+
+    g_writer.writeLine(ret.size());
+    for(int i = 0; i < ret.size(); i++){
+      g_writer.writeLine(ret[i]);
+    }
+    g_writer.flush();
+
+    // 次の入力を待つ間に、次のターンの危険度を先に調べておく
+    pd.startSpeculation();
+
+    trace.writeTurn(money, creeps, baseHealth, ret);
+  }
+
+  return 0;
+}
+#endif
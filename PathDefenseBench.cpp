@@ -0,0 +1,246 @@
+/**
+ * @file    PathDefenseBench.cpp
+ * @brief   複数のseedをまとめて評価するためのドライバ
+ * @author  siman
+ *
+ * @detail
+ * ソルバー(PathDefense.cpp)をそのまま取り込み、PathDefenseWorld.hのゲームの中で直接呼び出す。
+ * ソルバーはグローバル変数に状態を持つので、1ゲーム毎にforkした子プロセスで実行し、
+ * 同時に動かす子プロセスの数でコアを使い切る。
+ *
+ * 使い方
+ *   ./PathDefenseBench -seed 1001 -to 1100 [-jobs 4] [-verbose]
+ *   ./PathDefenseBench -seed 1 -to 1000 -diff 10 [-jar ./PathDefenseVis.jar] [-exec ./PathDefense]
+ *
+ *  -diff K を付けると範囲から均等にK個のseedを選び、Java版のテスターのスコアと一致するかを確認する
+ *
+ * ソルバーは持ち時間に応じて探索を深くするので、同時に動かすゲームが多いと結果が変わる。
+ * 実行毎に同じ結果が欲しい場合は -DPATH_DEFENSE_TIME_LIMIT=0 を付けてコンパイルする
+ *
+ * 子プロセスの数でコアを使い切るので、ソルバーのロールアウトは1スレッドで行う
+ */
+#define PATH_DEFENSE_NO_MAIN
+#define PATH_DEFENSE_MAX_THREAD 1
+#include "PathDefense.cpp"
+#include "PathDefenseWorld.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+/**
+ * @brief 実行中の子プロセス
+ */
+typedef struct runningGame {
+  pid_t pid;    // プロセスID
+  int fd;       // 結果を受け取るパイプ
+  int index;    // 何番目のseedか
+} RUNNING_GAME;
+
+/**
+ * @fn [complete]
+ * 子プロセスで1ゲームを行う
+ * @param (seed)    シード値
+ * @param (verbose) ソルバーの標準エラー出力を表示するかどうか
+ * @param (game)    起動した子プロセスの情報
+ */
+void startGame(long long seed, bool verbose, RUNNING_GAME *game){
+  int fds[2];
+  if(pipe(fds) != 0){
+    perror("pipe");
+    exit(1);
+  }
+
+  pid_t pid = fork();
+  if(pid < 0){
+    perror("fork");
+    exit(1);
+  }
+
+  if(pid == 0){
+    close(fds[0]);
+
+    if(!verbose){
+      int devNull = open("/dev/null", O_WRONLY);
+      dup2(devNull, 2);
+      close(devNull);
+    }
+
+    PathDefense pd;
+    vis::GAME_RESULT result = vis::playGame(pd, seed);
+
+    ssize_t written = write(fds[1], &result, sizeof(result));
+    _exit(written == sizeof(result)? 0 : 1);
+  }
+
+  close(fds[1]);
+  game->pid = pid;
+  game->fd  = fds[0];
+}
+
+/**
+ * @fn [complete]
+ * 子プロセスの終了を待って結果を受け取る
+ * @param (running) 実行中の子プロセスのリスト
+ * @param (results) 結果の書き込み先
+ *
+ * @return 終わったseedの番号
+ */
+int waitGame(vector<RUNNING_GAME> &running, vector<vis::GAME_RESULT> &results){
+  int status;
+  pid_t pid = waitpid(-1, &status, 0);
+
+  for(int i = 0; i < running.size(); i++){
+    if(running[i].pid != pid) continue;
+
+    RUNNING_GAME game = running[i];
+    running.erase(running.begin() + i);
+
+    vis::GAME_RESULT result;
+    if(read(game.fd, &result, sizeof(result)) != sizeof(result)){
+      // 途中で落ちた場合(assert等)
+      fprintf(stderr, "seed %lld: solver crashed\n", results[game.index].seed);
+      result = results[game.index];
+      result.score = -1;
+    }
+    close(game.fd);
+
+    results[game.index] = result;
+    return game.index;
+  }
+
+  fprintf(stderr, "unknown child process %d\n", (int)pid);
+  exit(1);
+}
+
+/**
+ * @fn [complete]
+ * 1ゲームの結果を表示する(analysis.rbで読めるようにScoreを先頭にする)
+ */
+void showResult(const vis::GAME_RESULT &result){
+  printf("Score = %d  N = %d  seed = %lld  towers = %d  time = %.1f ms  solver = %.1f ms  max turn = %.2f ms\n",
+      result.score, result.boardSize, result.seed, result.towerCount,
+      result.wallTime, result.solverTime, result.maxTurnTime);
+  fflush(stdout);
+}
+
+/**
+ * @fn [complete]
+ * Java版のテスターでスコアを取得する
+ * @param (jar)  PathDefenseVis.jarのパス
+ * @param (exec) ソルバーの実行コマンド
+ * @param (seed) シード値
+ *
+ * @return スコア(取得できなかった場合はINT_MIN)
+ */
+int runJavaTester(const string &jar, const string &exec, long long seed){
+  char command[1024];
+  snprintf(command, sizeof(command), "java -jar %s -seed %lld -novis -exec '%s' 2>/dev/null", jar.c_str(), seed, exec.c_str());
+
+  FILE *fp = popen(command, "r");
+  if(fp == NULL) return INT_MIN;
+
+  int score = INT_MIN;
+  char line[256];
+  while(fgets(line, sizeof(line), fp) != NULL){
+    sscanf(line, "Score = %d", &score);
+  }
+  pclose(fp);
+
+  return score;
+}
+
+int main(int argc, char **argv){
+  long long firstSeed = 1001;
+  long long lastSeed = UNDEFINED;
+  int jobs = max(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
+  int diffCount = 0;
+  bool verbose = false;
+  string jar = "./PathDefenseVis.jar";
+  string exec = "./PathDefense";
+
+  for(int i = 1; i < argc; i++){
+    string arg = argv[i];
+
+    if(arg == "-seed" && i+1 < argc){
+      firstSeed = atoll(argv[++i]);
+    }else if(arg == "-to" && i+1 < argc){
+      lastSeed = atoll(argv[++i]);
+    }else if(arg == "-jobs" && i+1 < argc){
+      jobs = max(1, atoi(argv[++i]));
+    }else if(arg == "-diff" && i+1 < argc){
+      diffCount = atoi(argv[++i]);
+    }else if(arg == "-jar" && i+1 < argc){
+      jar = argv[++i];
+    }else if(arg == "-exec" && i+1 < argc){
+      exec = argv[++i];
+    }else if(arg == "-verbose"){
+      verbose = true;
+    }else{
+      fprintf(stderr, "unknown argument %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if(lastSeed == UNDEFINED) lastSeed = firstSeed;
+
+  int seedCount = lastSeed - firstSeed + 1;
+  vector<vis::GAME_RESULT> results(seedCount);
+  vector<bool> finished(seedCount, false);
+  vector<RUNNING_GAME> running;
+
+  for(int i = 0; i < seedCount; i++){
+    results[i].seed = firstSeed + i;
+  }
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  int nextIndex = 0;
+  int shownCount = 0;
+
+  // seedの順番に表示する
+  while(shownCount < seedCount){
+    while(running.size() < jobs && nextIndex < seedCount){
+      RUNNING_GAME game;
+      game.index = nextIndex;
+      startGame(results[nextIndex].seed, verbose, &game);
+      running.push_back(game);
+      nextIndex++;
+    }
+
+    finished[waitGame(running, results)] = true;
+
+    while(shownCount < seedCount && finished[shownCount]){
+      showResult(results[shownCount++]);
+    }
+  }
+
+  ll totalScore = 0;
+  double maxTurnTime = 0.0;
+  for(int i = 0; i < seedCount; i++){
+    totalScore += results[i].score;
+    maxTurnTime = max(maxTurnTime, results[i].maxTurnTime);
+  }
+  printf("Total = %lld  Average = %.2f  Seeds = %d  Worst turn = %.2f ms  Elapsed = %.1f s\n",
+      totalScore, (double)totalScore / seedCount, seedCount, maxTurnTime, vis::elapsedMillis(start) / 1000.0);
+
+  if(diffCount <= 0) return 0;
+
+  // Java版のテスターと一致するかを確認
+  int mismatchCount = 0;
+  diffCount = min(diffCount, seedCount);
+  for(int i = 0; i < diffCount; i++){
+    int index = (ll)i * seedCount / diffCount;
+    vis::GAME_RESULT &result = results[index];
+    int javaScore = runJavaTester(jar, exec, result.seed);
+    bool match = (javaScore == result.score);
+
+    if(!match) mismatchCount++;
+    if(javaScore == INT_MIN){
+      printf("seed = %lld  native = %d  java = (failed to run %s)  MISMATCH\n", result.seed, result.score, jar.c_str());
+    }else{
+      printf("seed = %lld  native = %d  java = %d  %s\n", result.seed, result.score, javaScore, match? "MATCH" : "MISMATCH");
+    }
+  }
+  printf("Diff: %d / %d matched\n", diffCount - mismatchCount, diffCount);
+
+  return (mismatchCount == 0)? 0 : 1;
+}
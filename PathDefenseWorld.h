@@ -0,0 +1,773 @@
+/**
+ * @file    PathDefenseWorld.h
+ * @brief   PathDefenseVis.javaのテストケース生成とゲームの進行をC++に移植したもの
+ * @author  siman
+ *
+ * @detail
+ * JVMを起動せずに、ソルバーと同じプロセスの中でゲームを進めるために使う。
+ * 乱数(SHA1PRNG)も含めてJava版と同じ順番で同じ値を引くので、同じseedであれば同じ盤面・同じスコアになる。
+ * ソルバー側の名前とぶつからないように全てvis名前空間に入れている
+ */
+#ifndef PATH_DEFENSE_WORLD_H
+#define PATH_DEFENSE_WORLD_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdint.h>
+
+namespace vis {
+
+using namespace std;
+
+const int SIMULATION_TIME   = 2000;  //! ターンの数
+const int BASE_INIT_HEALTH  = 1000;  //! 基地の初期体力
+
+const int MIN_CREEP_HEALTH  = 1;
+const int MAX_CREEP_HEALTH  = 20;
+const int MIN_CREEP_MONEY   = 1;
+const int MAX_CREEP_MONEY   = 20;
+const int MIN_TOWER_RANGE   = 1;
+const int MAX_TOWER_RANGE   = 5;
+const int MIN_TOWER_DAMAGE  = 1;
+const int MAX_TOWER_DAMAGE  = 5;
+const int MIN_TOWER_COST    = 5;
+const int MAX_TOWER_COST    = 40;
+const int MIN_CREEP_COUNT   = 500;
+const int MAX_CREEP_COUNT   = 2000;
+const int MIN_TOWER_TYPES   = 1;
+const int MAX_TOWER_TYPES   = 20;
+const int MIN_BASE_COUNT    = 1;
+const int MAX_BASE_COUNT    = 8;
+const int MIN_WAVE_COUNT    = 1;
+const int MAX_WAVE_COUNT    = 15;
+const int MIN_BOARD_SIZE    = 20;
+const int MAX_BOARD_SIZE    = 60;
+
+//! 方向(Java版のConstantsと同じ並び)
+const int DY[4] = { 1, 0, -1, 0 };
+const int DX[4] = { 0, -1, 0, 1 };
+
+/**
+ * @brief SHA-1のハッシュ関数
+ */
+typedef struct sha1 {
+  static uint32_t rotateLeft(uint32_t value, int shift){
+    return (value << shift) | (value >> (32 - shift));
+  }
+
+  /**
+   * @fn [complete]
+   * ハッシュ値を計算する
+   * @param (message) 入力
+   * @param (length)  入力のバイト数
+   * @param (digest)  出力(20バイト)
+   */
+  static void calc(const uint8_t *message, size_t length, uint8_t digest[20]){
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    size_t total = ((length + 8) / 64 + 1) * 64;
+    vector<uint8_t> buffer(total, 0);
+
+    // パディング(末尾にビット長をビッグエンディアンで入れる)
+    memcpy(buffer.data(), message, length);
+    buffer[length] = 0x80;
+    uint64_t bits = (uint64_t)length * 8;
+    for(int i = 0; i < 8; i++){
+      buffer[total-1-i] = (uint8_t)(bits >> (8*i));
+    }
+
+    for(size_t offset = 0; offset < total; offset += 64){
+      uint32_t w[80];
+
+      for(int i = 0; i < 16; i++){
+        const uint8_t *p = &buffer[offset + 4*i];
+        w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+      }
+      for(int i = 16; i < 80; i++){
+        w[i] = rotateLeft(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+      }
+
+      uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+      for(int i = 0; i < 80; i++){
+        uint32_t f, k;
+
+        if(i < 20){
+          f = (b & c) | (~b & d);
+          k = 0x5A827999;
+        }else if(i < 40){
+          f = b ^ c ^ d;
+          k = 0x6ED9EBA1;
+        }else if(i < 60){
+          f = (b & c) | (b & d) | (c & d);
+          k = 0x8F1BBCDC;
+        }else{
+          f = b ^ c ^ d;
+          k = 0xCA62C1D6;
+        }
+
+        uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+        e = d; d = c; c = rotateLeft(b, 30); b = a; a = temp;
+      }
+
+      h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    for(int i = 0; i < 5; i++){
+      for(int j = 0; j < 4; j++){
+        digest[4*i+j] = (uint8_t)(h[i] >> (24 - 8*j));
+      }
+    }
+  }
+} SHA1;
+
+/**
+ * @brief JavaのSecureRandom("SHA1PRNG")とRandom.nextIntの移植
+ *
+ * @detail
+ * setSeed(long)だけで初期化した場合と同じ乱数列を返す(状態の更新は符号付きbyteの計算をそのまま真似る)
+ */
+typedef struct javaSecureRandom {
+  int8_t state[20];       // 内部状態
+  int8_t remainder[20];   // 前回の出力の使い残し
+  int remCount;           // 使い残しの位置
+
+  javaSecureRandom(long long seed){
+    // longを下位バイトから順に並べたものをSHA-1にかけて初期状態にする
+    uint8_t bytes[8];
+    for(int i = 0; i < 8; i++){
+      bytes[i] = (uint8_t)seed;
+      seed >>= 8;
+    }
+
+    uint8_t digest[20];
+    SHA1::calc(bytes, 8, digest);
+    memcpy(state, digest, 20);
+    memset(remainder, 0, sizeof(remainder));
+    remCount = 0;
+  }
+
+  /**
+   * @fn [complete]
+   * 出力を使って内部状態を更新する
+   * @param (output) 今回の出力
+   */
+  void updateState(const int8_t *output){
+    int last = 1;
+    bool changed = false;
+
+    for(int i = 0; i < 20; i++){
+      int value = (int)state[i] + (int)output[i] + last;
+      int8_t next = (int8_t)value;
+
+      changed = changed || (state[i] != next);
+      state[i] = next;
+      last = value >> 8;
+    }
+
+    if(!changed) state[0]++;
+  }
+
+  /**
+   * @fn [complete]
+   * 乱数のバイト列を作る
+   * @param (result) 出力先
+   * @param (length) バイト数
+   */
+  void nextBytes(int8_t *result, int length){
+    int index = 0;
+    int r = remCount;
+
+    // 前回の使い残しから使う
+    if(r > 0){
+      int todo = min(length - index, 20 - r);
+      for(int i = 0; i < todo; i++){
+        result[i] = remainder[r];
+        remainder[r++] = 0;
+      }
+      remCount += todo;
+      index += todo;
+    }
+
+    while(index < length){
+      uint8_t digest[20];
+      SHA1::calc((const uint8_t*)state, 20, digest);
+      memcpy(remainder, digest, 20);
+      updateState(remainder);
+
+      int todo = min(length - index, 20);
+      for(int i = 0; i < todo; i++){
+        result[index++] = remainder[i];
+        remainder[i] = 0;
+      }
+      remCount += todo;
+    }
+
+    remCount %= 20;
+  }
+
+  /**
+   * @fn [complete]
+   * 指定したビット数の乱数を返す(Random.next)
+   */
+  int next(int numBits){
+    int numBytes = (numBits + 7) / 8;
+    int8_t bytes[8];
+    nextBytes(bytes, numBytes);
+
+    uint32_t value = 0;
+    for(int i = 0; i < numBytes; i++){
+      value = (value << 8) + (uint8_t)bytes[i];
+    }
+
+    return (int)(value >> (numBytes * 8 - numBits));
+  }
+
+  /**
+   * @fn [complete]
+   * [0, bound)の乱数を返す(Random.nextInt)
+   */
+  int nextInt(int bound){
+    int r = next(31);
+    int m = bound - 1;
+
+    if((bound & m) == 0) return (int)(((long long)bound * r) >> 31);
+
+    for(int u = r; (int)((uint32_t)u - (uint32_t)(r = u % bound) + (uint32_t)m) < 0; u = next(31));
+
+    return r;
+  }
+} JAVA_SECURE_RANDOM;
+
+/**
+ * @brief 敵を表す構造体
+ */
+typedef struct creep {
+  int id;             // ID
+  int health;         // 体力
+  int x;              // x座標
+  int y;              // y座標
+  int spawnTime;      // 出現するターン
+  vector<int> moves;  // 毎ターンの移動方向
+} CREEP;
+
+/**
+ * @brief タワーの種類を表す構造体
+ */
+typedef struct towerType {
+  int range;    // 射程距離
+  int damage;   // 攻撃力
+  int cost;     // 建設コスト
+} TOWER_TYPE;
+
+/**
+ * @brief 建設されたタワーを表す構造体
+ */
+typedef struct tower {
+  int x;      // x座標
+  int y;      // y座標
+  int type;   // タワーの種類
+} TOWER;
+
+/**
+ * @brief テストケース(Java版のTestCaseと同じ手順で生成する)
+ */
+typedef struct testCase {
+  int boardSize;                  // ボードの大きさ
+  int money;                      // 初期の所持金
+  int creepHealth;                // 敵の初期体力
+  int creepMoney;                 // 敵を倒した時の報酬
+  int towerTypeCount;             // タワーの種類の数
+  vector<TOWER_TYPE> towerTypes;  // タワーの種類
+  vector<string> board;           // ボード
+  vector<vector<int> > boardPath; // セルから進める方向のフラグ
+  int pathCount;                  // 経路の数
+  vector<int> spawnX;             // 出現ポイントのx座標
+  vector<int> spawnY;             // 出現ポイントのy座標
+  int baseCount;                  // 基地の数
+  vector<int> baseX;              // 基地のx座標
+  vector<int> baseY;              // 基地のy座標
+  int creepCount;                 // 敵の数
+  vector<CREEP> creeps;           // 敵
+  int waveCount;                  // 波状攻撃の回数
+  JAVA_SECURE_RANDOM rnd;         // 乱数
+
+  /**
+   * @fn [complete]
+   * 基地の文字かどうか
+   */
+  static bool isBase(char ch){
+    return ch >= '0' && ch <= '9';
+  }
+
+  /**
+   * @fn [complete]
+   * 出現ポイントと基地の接続を行う
+   * @param (x1) 出現ポイントのx座標
+   * @param (y1) 出現ポイントのy座標
+   * @param (x2) 基地のx座標
+   * @param (y2) 基地のy座標
+   */
+  void connect(int x1, int y1, int x2, int y2){
+    while(x1 != x2 || y1 != y2){
+      // 目的地以外の基地についたら抜ける
+      if(isBase(board[y1][x1])) return;
+
+      board[y1][x1] = '.';
+      int px = x1;
+      int py = y1;
+
+      if(x1 == x2){
+        if(y2 > y1) y1++; else y1--;
+      }else if(y1 == y2){
+        if(x2 > x1) x1++; else x1--;
+      }else{
+        int nx = x1;
+        int ny = y1;
+        if(x2 > x1) nx++; else nx--;
+        if(y2 > y1) ny++; else ny--;
+
+        // すでに経路が存在している場合はそこを優先
+        if(board[ny][x1] == '.'){
+          y1 = ny;
+        }else if(board[y1][nx] == '.'){
+          x1 = nx;
+        }else{
+          if(rnd.nextInt(2) == 0){
+            y1 = ny;
+          }else{
+            x1 = nx;
+          }
+        }
+      }
+
+      // 現在のセルからどの方角に行動できるのかをフラグで管理
+      if(x1 > px) boardPath[py][px] |= 8;
+      else if(x1 < px) boardPath[py][px] |= 2;
+      else if(y1 > py) boardPath[py][px] |= 1;
+      else if(y1 < py) boardPath[py][px] |= 4;
+    }
+  }
+
+  /**
+   * @fn [complete]
+   * 経路の追加を行う
+   * @param (pathId) 経路の番号
+   */
+  void addPath(int pathId){
+    int sx = 0, sy = 0;
+    bool nextTo = false;
+    int tryEdge = 0;
+
+    do{
+      tryEdge++;
+      if(tryEdge > boardSize) break;
+      nextTo = false;
+      sx = rnd.nextInt(boardSize-1) + 1;
+
+      if(rnd.nextInt(2) == 0){
+        sy = rnd.nextInt(2) * (boardSize-1);
+        if(sx > 0 && board[sy][sx-1] == '.') nextTo = true;
+        if(sx+1 < boardSize && board[sy][sx+1] == '.') nextTo = true;
+      }else{
+        sy = sx;
+        sx = rnd.nextInt(2) * (boardSize-1);
+        if(sy > 0 && board[sy-1][sx] == '.') nextTo = true;
+        if(sy+1 < boardSize && board[sy+1][sx] == '.') nextTo = true;
+      }
+    }while(nextTo || board[sy][sx] != '#');
+
+    if(tryEdge > boardSize) return;
+
+    // 出現ポイントを作成
+    board[sy][sx] = '.';
+    spawnX[pathId] = sx;
+    spawnY[pathId] = sy;
+
+    if(sx == 0){
+      boardPath[sy][sx] |= 8; sx++;
+    }else if(sy == 0){
+      boardPath[sy][sx] |= 1; sy++;
+    }else if(sx == boardSize-1){
+      boardPath[sy][sx] |= 2; sx--;
+    }else{
+      boardPath[sy][sx] |= 4; sy--;
+    }
+
+    // 最低でも1つの基地に向かう経路は作成して、あとはランダムで作る
+    int baseId = pathId % baseCount;
+    if(pathId >= baseCount) baseId = rnd.nextInt(baseCount);
+
+    connect(sx, sy, baseX[baseId], baseY[baseId]);
+  }
+
+  /**
+   * @fn [complete]
+   * 敵の移動経路を決める
+   *
+   * @return 全ての敵が基地に到達出来たかどうか
+   */
+  bool generateCreepMoves(){
+    for(int i = 0; i < creepCount; i++){
+      CREEP &c = creeps[i];
+      c.moves.clear();
+
+      int x = c.x;
+      int y = c.y;
+      int prevX = -1;
+      int prevY = -1;
+      int tryPath = 0;
+
+      while(!isBase(board[y][x])){
+        int dir = 0;
+        tryPath++;
+        if(tryPath > boardSize * boardSize) break;
+
+        // 基地に向かう方向をランダムに選ぶ(直前にいたセルには戻らない)
+        int tryDir = 0;
+        do{
+          if(tryDir == 15){
+            tryDir = -1;
+            break;
+          }
+          dir = rnd.nextInt(4);
+          tryDir |= (1 << dir);
+        }while((boardPath[y][x] & (1 << dir)) == 0 || (x + DX[dir] == prevX && y + DY[dir] == prevY));
+
+        if(tryDir < 0) break;
+
+        c.moves.push_back(dir);
+        prevX = x;
+        prevY = y;
+        x += DX[dir];
+        y += DY[dir];
+      }
+
+      if(!isBase(board[y][x])) return false;
+    }
+
+    return true;
+  }
+
+  testCase(long long seed) : rnd(seed){
+    do{
+      boardSize = rnd.nextInt(MAX_BOARD_SIZE - MIN_BOARD_SIZE + 1) + MIN_BOARD_SIZE;
+      if(seed == 1) boardSize = 20;
+
+      board.assign(boardSize, string(boardSize, '#'));
+      boardPath.assign(boardSize, vector<int>(boardSize, 0));
+
+      creepHealth = rnd.nextInt(MAX_CREEP_HEALTH - MIN_CREEP_HEALTH + 1) + MIN_CREEP_HEALTH;
+      creepMoney  = rnd.nextInt(MAX_CREEP_MONEY - MIN_CREEP_MONEY + 1) + MIN_CREEP_MONEY;
+
+      // タワーの種類(初期の所持金は全種類のコストの合計)
+      towerTypeCount = rnd.nextInt(MAX_TOWER_TYPES - MIN_TOWER_TYPES + 1) + MIN_TOWER_TYPES;
+      towerTypes.assign(towerTypeCount, TOWER_TYPE());
+      money = 0;
+      for(int i = 0; i < towerTypeCount; i++){
+        towerTypes[i].range   = rnd.nextInt(MAX_TOWER_RANGE - MIN_TOWER_RANGE + 1) + MIN_TOWER_RANGE;
+        towerTypes[i].damage  = rnd.nextInt(MAX_TOWER_DAMAGE - MIN_TOWER_DAMAGE + 1) + MIN_TOWER_DAMAGE;
+        towerTypes[i].cost    = rnd.nextInt(MAX_TOWER_COST - MIN_TOWER_COST + 1) + MIN_TOWER_COST;
+        money += towerTypes[i].cost;
+      }
+
+      // 基地(ボードの端から4マス以上離す)
+      baseCount = rnd.nextInt(MAX_BASE_COUNT - MIN_BASE_COUNT + 1) + MIN_BASE_COUNT;
+      baseX.assign(baseCount, 0);
+      baseY.assign(baseCount, 0);
+      for(int i = 0; i < baseCount; i++){
+        int bx, by;
+        do{
+          bx = rnd.nextInt(boardSize-8) + 4;
+          by = rnd.nextInt(boardSize-8) + 4;
+        }while(board[by][bx] != '#');
+
+        board[by][bx] = (char)('0' + i);
+        baseX[i] = bx;
+        baseY[i] = by;
+      }
+
+      // 経路
+      pathCount = rnd.nextInt(baseCount*10 - baseCount + 1) + baseCount;
+      spawnX.assign(pathCount, 0);
+      spawnY.assign(pathCount, 0);
+      for(int i = 0; i < pathCount; i++){
+        addPath(i);
+      }
+
+      // 敵(体力は500ターン毎に倍々で増える)
+      creepCount = rnd.nextInt(MAX_CREEP_COUNT - MIN_CREEP_COUNT + 1) + MIN_CREEP_COUNT;
+      if(seed == 1) creepCount = MIN_CREEP_COUNT;
+      creeps.assign(creepCount, CREEP());
+      for(int i = 0; i < creepCount; i++){
+        CREEP &c = creeps[i];
+        int j = rnd.nextInt(pathCount);
+
+        c.x         = spawnX[j];
+        c.y         = spawnY[j];
+        c.id        = i;
+        c.spawnTime = rnd.nextInt(SIMULATION_TIME);
+        c.health    = creepHealth * (1 << (c.spawnTime / 500));
+      }
+
+      // 波状攻撃(先頭の敵から順に出現ポイントと時間を上書きする)
+      waveCount = rnd.nextInt(MAX_WAVE_COUNT - MIN_WAVE_COUNT + 1) + MIN_WAVE_COUNT;
+      int wi = 0;
+      for(int w = 0; w < waveCount; w++){
+        int wavePath = rnd.nextInt(pathCount);
+        int waveSize = 5 + rnd.nextInt(creepCount / 20);
+        int waveStartT = rnd.nextInt(SIMULATION_TIME - waveSize);
+
+        for(int i = 0; i < waveSize; i++){
+          if(wi >= creepCount) break;
+
+          creeps[wi].x          = spawnX[wavePath];
+          creeps[wi].y          = spawnY[wavePath];
+          creeps[wi].spawnTime  = waveStartT + rnd.nextInt(waveSize);
+          creeps[wi].health     = creepHealth * (1 << (creeps[wi].spawnTime / 500));
+          wi++;
+        }
+        if(wi >= creepCount) break;
+      }
+
+      // 基地に到達できない敵が1体でもいたらフィールドを作成し直す
+    }while(!generateCreepMoves());
+  }
+} TEST_CASE;
+
+/**
+ * @brief ゲームの状態(Java版のWorldと同じ順番で処理する)
+ */
+typedef struct world {
+  TEST_CASE tc;               // テストケース(ボードと敵はゲーム中に書き換わる)
+  int totMoney;               // 所持金
+  int curStep;                // 現在のターン
+  vector<int> baseHealth;     // 基地の体力
+  vector<TOWER> towers;       // 建設されたタワー(建設順)
+
+  world(long long seed) : tc(seed){
+    totMoney  = tc.money;
+    curStep   = -1;
+    baseHealth.assign(tc.baseCount, BASE_INIT_HEALTH);
+  }
+
+  /**
+   * @fn [complete]
+   * 次のターンに進める
+   */
+  void startNewStep(){
+    curStep++;
+  }
+
+  /**
+   * @fn [complete]
+   * ソルバーに渡す敵の情報(id, 体力, x, y)を作る
+   */
+  vector<int> creepsData(){
+    vector<int> data;
+
+    for(int i = 0; i < tc.creepCount; i++){
+      CREEP &c = tc.creeps[i];
+
+      if(c.health > 0 && c.spawnTime < curStep){
+        data.push_back(c.id);
+        data.push_back(c.health);
+        data.push_back(c.x);
+        data.push_back(c.y);
+      }
+    }
+
+    return data;
+  }
+
+  /**
+   * @fn [complete]
+   * ソルバーの建設情報(x, y, 種類の繰り返し)を反映する
+   * @param (commands) 建設情報
+   *
+   * @return 正しい建設情報だったかどうか(Java版ではエラーになる場合にfalse)
+   */
+  bool placeTowers(const vector<int> &commands){
+    if(commands.size() > tc.boardSize * tc.boardSize * 3) return false;
+    if(commands.size() % 3 != 0) return false;
+
+    for(int i = 0; i < commands.size(); i += 3){
+      TOWER t;
+      t.x     = commands[i];
+      t.y     = commands[i+1];
+      t.type  = commands[i+2];
+
+      if(t.x < 0 || t.x >= tc.boardSize || t.y < 0 || t.y >= tc.boardSize) return false;
+      if(tc.board[t.y][t.x] != '#') return false;
+      if(t.type < 0 || t.type >= tc.towerTypeCount) return false;
+      if(totMoney < tc.towerTypes[t.type].cost) return false;
+
+      totMoney -= tc.towerTypes[t.type].cost;
+      tc.board[t.y][t.x] = (char)('A' + t.type);
+      towers.push_back(t);
+    }
+
+    return true;
+  }
+
+  /**
+   * @fn [complete]
+   * 敵を移動させる(基地に到達した敵は基地の体力を削って消える)
+   */
+  void updateCreeps(){
+    for(int i = 0; i < tc.creepCount; i++){
+      CREEP &c = tc.creeps[i];
+
+      if(c.health > 0 && c.spawnTime < curStep){
+        int dir = c.moves[curStep - c.spawnTime - 1];
+        c.x += DX[dir];
+        c.y += DY[dir];
+
+        if(TEST_CASE::isBase(tc.board[c.y][c.x])){
+          int baseId = tc.board[c.y][c.x] - '0';
+          baseHealth[baseId] = max(0, baseHealth[baseId] - c.health);
+          c.health = 0;
+        }
+      }
+    }
+  }
+
+  /**
+   * @fn [complete]
+   * 建設順に各タワーが一番近い敵を攻撃する(同じ距離の場合はIDの小さい敵)
+   */
+  void updateAttack(){
+    for(int t = 0; t < towers.size(); t++){
+      TOWER &tower = towers[t];
+      TOWER_TYPE &type = tc.towerTypes[tower.type];
+      int target = -1;
+      int targetDist = 1 << 29;
+
+      for(int i = 0; i < tc.creepCount; i++){
+        CREEP &c = tc.creeps[i];
+        if(c.health <= 0 || c.spawnTime > curStep) continue;
+
+        int dist = (tower.x - c.x) * (tower.x - c.x) + (tower.y - c.y) * (tower.y - c.y);
+        if(dist > type.range * type.range) continue;
+
+        if(dist < targetDist || (dist == targetDist && c.id < tc.creeps[target].id)){
+          targetDist = dist;
+          target = i;
+        }
+      }
+
+      if(target >= 0){
+        tc.creeps[target].health -= type.damage;
+
+        // 倒したら報酬
+        if(tc.creeps[target].health <= 0){
+          totMoney += tc.creepMoney;
+        }
+      }
+    }
+  }
+
+  /**
+   * @fn [complete]
+   * スコア(所持金と基地の体力の合計)
+   */
+  int score(){
+    int total = totMoney;
+
+    for(int i = 0; i < baseHealth.size(); i++){
+      total += baseHealth[i];
+    }
+
+    return total;
+  }
+} WORLD;
+
+/**
+ * @brief 1ゲーム分の結果
+ */
+typedef struct gameResult {
+  long long seed;     // シード値
+  int score;          // スコア(不正な建設情報を返した場合は-1)
+  int boardSize;      // ボードの大きさ
+  int towerCount;     // 建設したタワーの数
+  double wallTime;    // ゲーム全体にかかった時間(ms)
+  double solverTime;  // ソルバーの処理時間の合計(ms)
+  double maxTurnTime; // 1ターンのplaceTowersの最大の処理時間(ms)
+} GAME_RESULT;
+
+/**
+ * @fn [complete]
+ * 経過時間をミリ秒で返す
+ */
+inline double elapsedMillis(chrono::steady_clock::time_point from){
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - from).count();
+}
+
+/**
+ * @fn [complete]
+ * ソルバーを同じプロセスの中で呼び出して1ゲームを行う
+ * @param (solver) init/placeTowersを持つソルバー
+ * @param (seed)   シード値
+ *
+ * @return ゲームの結果
+ * @detail
+ * Java版のrunTestと同じ順番で、毎ターン「入力を渡す → 建設 → 敵の移動 → タワーの攻撃」を行う
+ */
+template<class SOLVER>
+GAME_RESULT playGame(SOLVER &solver, long long seed){
+  chrono::steady_clock::time_point gameStart = chrono::steady_clock::now();
+  WORLD world(seed);
+  TEST_CASE &tc = world.tc;
+
+  GAME_RESULT result;
+  result.seed         = seed;
+  result.score        = -1;
+  result.boardSize    = tc.boardSize;
+  result.towerCount   = 0;
+  result.solverTime   = 0.0;
+  result.maxTurnTime  = 0.0;
+
+  vector<int> towerTypeData;
+  for(int i = 0; i < tc.towerTypeCount; i++){
+    towerTypeData.push_back(tc.towerTypes[i].range);
+    towerTypeData.push_back(tc.towerTypes[i].damage);
+    towerTypeData.push_back(tc.towerTypes[i].cost);
+  }
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  solver.init(tc.board, tc.money, tc.creepHealth, tc.creepMoney, towerTypeData);
+  result.solverTime += elapsedMillis(start);
+
+  for(int turn = 0; turn < SIMULATION_TIME; turn++){
+    world.startNewStep();
+
+    vector<int> creeps = world.creepsData();
+
+    start = chrono::steady_clock::now();
+    const vector<int> &commands = solver.placeTowers(creeps, world.totMoney, world.baseHealth);
+    double turnTime = elapsedMillis(start);
+
+    result.solverTime += turnTime;
+    result.maxTurnTime = max(result.maxTurnTime, turnTime);
+
+    if(!world.placeTowers(commands)){
+      result.wallTime = elapsedMillis(gameStart);
+      return result;
+    }
+
+    world.updateCreeps();
+    world.updateAttack();
+  }
+
+  result.score      = world.score();
+  result.towerCount = world.towers.size();
+  result.wallTime   = elapsedMillis(gameStart);
+
+  return result;
+}
+
+} // namespace vis
+
+#endif